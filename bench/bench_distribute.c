@@ -0,0 +1,148 @@
+/*
+ * Cost of event D when the catalog arrives in several drops.
+ *
+ * The same random catalog is distributed once in a single drop and
+ * then in repeated smaller drops, each merged by split_list into the
+ * category lists already filled by the previous ones. Only split_list
+ * is timed, the new movies list of each drop is built beforehand.
+ * The category lists and their year indexes are checked at the end.
+ *
+ * Build with: make bench
+ * Run:        ./bench/bench_distribute [movies]
+*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "streaming_service.h"
+#include "streaming_internal.h"
+#include "cleaning_functions.h"
+
+#define MIN_YEAR 1950
+#define MAX_YEAR 2024
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int CompareMid(const void* a, const void* b) {
+    const struct new_movie* x = (const struct new_movie*) a;
+    const struct new_movie* y = (const struct new_movie*) b;
+    return (x->info.mid > y->info.mid) - (x->info.mid < y->info.mid);
+}
+
+/* Make new_movies_list out of movies[0..n), sorted by mid as event A keeps it */
+static void BuildDrop(struct new_movie* movies, unsigned n) {
+    struct new_movie* node;
+    unsigned i;
+
+    qsort(movies, n, sizeof(struct new_movie), CompareMid);
+
+    new_movies_list = NULL;
+    for (i = n; i-- > 0;) {
+        node = (struct new_movie*) PoolAlloc(&new_movie_pool);
+        if (node == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            exit(EXIT_FAILURE);
+        }
+        (*node) = movies[i];
+        node->next = new_movies_list;
+        new_movies_list = node;
+    }
+}
+
+/* Returns 0 if every list and year bucket is sorted and n movies are inside */
+static int CheckTable(unsigned n) {
+    const struct category_list* L;
+    unsigned total = 0;
+    unsigned indexed = 0;
+    unsigned i, b, j;
+
+    for (i = 0; i < 6; ++i) {
+        L = &category_array[i];
+        total += L->size;
+        for (j = 1; j < L->size; ++j) {
+            if (L->mids[j - 1] >= L->mids[j]) return -1;
+        }
+        for (b = 0; b < L->nbuckets; ++b) {
+            indexed += L->buckets[b].size;
+            for (j = 1; j < L->buckets[b].size; ++j) {
+                if (L->buckets[b].mids[j - 1] >= L->buckets[b].mids[j]) return -1;
+            }
+        }
+    }
+
+    return (total == n && indexed == n) ? 0 : -1;
+}
+
+int main(int argc, char* argv[]) {
+    unsigned n = (argc > 1) ? (unsigned)strtoul(argv[1], NULL, 10) : 100000;
+    const unsigned drop_sizes[] = {0 /* all at once */, 10000, 1000, 100};
+    struct new_movie* catalog;
+    struct new_movie* drop;
+    unsigned i, j, d, size;
+    double t, total;
+
+    catalog = (struct new_movie*) malloc((n + 1) * sizeof(struct new_movie));
+    drop = (struct new_movie*) malloc((n + 1) * sizeof(struct new_movie));
+    if (catalog == NULL || drop == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Distinct mids in random order */
+    srand(240);
+    for (i = 0; i < n; ++i) {
+        catalog[i].info.mid = 2 * i;
+        catalog[i].info.year = MIN_YEAR + (unsigned)rand() % (MAX_YEAR - MIN_YEAR + 1);
+        catalog[i].category = (movieCategory_t)(rand() % 6);
+    }
+    for (i = n; i > 1; --i) {
+        j = (unsigned)rand() % i;
+        drop[0] = catalog[i - 1];
+        catalog[i - 1] = catalog[j];
+        catalog[j] = drop[0];
+    }
+
+    PoolInit(&new_movie_pool, "new_movie", sizeof(struct new_movie));
+    HashTableInit(&movie_index, 64);
+    HashTableInit(&new_movie_index, 64);
+
+    printf("%9s %7s %10s %12s\n", "drop", "drops", "total ms", "ns/movie");
+
+    for (d = 0; d < sizeof(drop_sizes) / sizeof(drop_sizes[0]); ++d) {
+        size = (drop_sizes[d] == 0 || drop_sizes[d] > n) ? n : drop_sizes[d];
+        total = 0;
+
+        for (i = 0; i < n; i += size) {
+            j = (n - i < size) ? n - i : size;
+            memcpy(drop, &catalog[i], j * sizeof(struct new_movie));
+            BuildDrop(drop, j);
+
+            t = Now();
+            split_list();
+            total += Now() - t;
+        }
+
+        if (CheckTable(n) == -1) {
+            fprintf(stderr, "Drops of %u movies give a wrong category table\n", size);
+            return EXIT_FAILURE;
+        }
+
+        printf("%9u %7u %10.2f %12.1f\n", size, (n + size - 1) / size,
+               total * 1e3, total * 1e9 / n);
+
+        for (i = 0; i < 6; ++i) CleanCategoryList(&category_array[i]);
+    }
+
+    HashTableDestroy(&movie_index);
+    HashTableDestroy(&new_movie_index);
+    PoolDestroy(&new_movie_pool);
+    free(catalog);
+    free(drop);
+    return 0;
+}
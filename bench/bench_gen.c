@@ -0,0 +1,205 @@
+/*
+ * Synthetic event file generator.
+ *
+ * Writes an event file to stdout: a prelude that registers every user
+ * and adds and distributes the whole catalog, then the given number of
+ * random events drawn from an event mix. Users and movies are picked
+ * with Zipf popularity (id 0 is the most popular), so a few users watch
+ * most and a few movies are watched most, as in a real service. Movies
+ * are taken off at a given rate, in bursts of consecutive T events.
+ *
+ * The output depends only on the options: the random numbers come
+ * from a generator of our own, not from rand().
+ *
+ * Build with: make bench
+ * Run:        ./bench/bench_gen [options] > events.txt
+ *   -u users      users (1000)
+ *   -m movies     movies in the catalog at the start (10000)
+ *   -e events     events after the prelude (100000)
+ *   -z exponent   Zipf exponent of the popularity, 0 for uniform (1.0)
+ *   -t rate       T events per 1000 events (5)
+ *   -b burst      T events in a burst (4)
+ *   -x mix        weights of the other events, as letters followed by
+ *                 numbers (W40S10F8Q4A10D1R3U3)
+ *   -s seed       random seed (240)
+*/
+#define _POSIX_C_SOURCE 2
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIN_YEAR 1950
+#define MAX_YEAR 2024
+
+/* Event letters the mix may name */
+#define MIX_EVENTS "RUADWSFQMP"
+
+/* xorshift32 state, never 0 */
+static unsigned long state;
+
+/* Next 32 bit random number */
+static unsigned long Next(void) {
+    state ^= (state << 13) & 0xFFFFFFFFUL;
+    state ^= state >> 17;
+    state ^= (state << 5) & 0xFFFFFFFFUL;
+    return state;
+}
+
+/* Uniform in [0, n) */
+static unsigned long Uniform(unsigned long n) {
+    return Next() % n;
+}
+
+/* Uniform in [0, 1) */
+static double UniformReal(void) {
+    return Next() * (1.0 / 4294967296.0);
+}
+
+/* Cumulative Zipf distribution over n ranks */
+struct zipf {
+    double* cdf;
+    unsigned long n;
+};
+
+static int ZipfInit(struct zipf* Z, unsigned long n, double exponent) {
+    double sum = 0;
+    unsigned long i;
+
+    Z->n = n;
+    Z->cdf = (double*) malloc((n + 1) * sizeof(double));
+    if (Z->cdf == NULL) return -1;
+
+    for (i = 0; i < n; ++i) {
+        sum += 1.0 / pow((double)(i + 1), exponent);
+        Z->cdf[i] = sum;
+    }
+    for (i = 0; i < n; ++i) Z->cdf[i] /= sum;
+
+    return 0;
+}
+
+/* Rank in [0, n), rank 0 the most likely */
+static unsigned long ZipfNext(const struct zipf* Z) {
+    double u = UniformReal();
+    unsigned long lo = 0, hi = Z->n - 1, m;
+
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        if (Z->cdf[m] < u) lo = m + 1;
+        else hi = m;
+    }
+
+    return lo;
+}
+
+/* Parse mix, like "W40S10", to weights indexed as MIX_EVENTS. Returns -1 if malformed. */
+static int ParseMix(const char* mix, unsigned long weights[]) {
+    const char* letter;
+    char* end;
+
+    memset(weights, 0, strlen(MIX_EVENTS) * sizeof(unsigned long));
+
+    while (*mix != '\0') {
+        letter = strchr(MIX_EVENTS, *mix);
+        if (letter == NULL) return -1;
+        weights[letter - MIX_EVENTS] = strtoul(mix + 1, &end, 10);
+        if (end == mix + 1) return -1;
+        mix = end;
+    }
+
+    return 0;
+}
+
+static void Usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-u users] [-m movies] [-e events] [-z exponent]\n"
+                    "          [-t takeoffs per 1000] [-b burst] [-x mix] [-s seed]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long users = 1000, movies = 10000, events = 100000;
+    unsigned long rate = 5, burst = 4, seed = 240;
+    double exponent = 1.0;
+    const char* mix = "W40S10F8Q4A10D1R3U3";
+    unsigned long weights[sizeof(MIX_EVENTS) - 1];
+    unsigned long total = 0;
+    unsigned long next_mid;
+    unsigned long i, b, x;
+    struct zipf user_pop, movie_pop;
+    int e, opt;
+
+    while ((opt = getopt(argc, argv, "u:m:e:z:t:b:x:s:")) != -1) {
+        switch (opt) {
+            case 'u': users = strtoul(optarg, NULL, 10); break;
+            case 'm': movies = strtoul(optarg, NULL, 10); break;
+            case 'e': events = strtoul(optarg, NULL, 10); break;
+            case 'z': exponent = atof(optarg); break;
+            case 't': rate = strtoul(optarg, NULL, 10); break;
+            case 'b': burst = strtoul(optarg, NULL, 10); break;
+            case 'x': mix = optarg; break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            default: Usage(argv[0]);
+        }
+    }
+    if (users == 0 || movies == 0 || burst == 0 || rate > 1000 || ParseMix(mix, weights) == -1) {
+        Usage(argv[0]);
+    }
+    for (e = 0; MIX_EVENTS[e] != '\0'; ++e) total += weights[e];
+    if (total == 0) Usage(argv[0]);
+
+    if (ZipfInit(&user_pop, users, exponent) == -1 || ZipfInit(&movie_pop, movies, exponent) == -1) {
+        fprintf(stderr, "Malloc error\n");
+        return EXIT_FAILURE;
+    }
+    state = (0x9E3779B9UL ^ seed) & 0xFFFFFFFFUL;
+    if (state == 0) state = 1;
+
+    /* Prelude: every user and the whole catalog */
+    for (i = 0; i < users; ++i) printf("R %lu\n", i);
+    for (i = 0; i < movies; ++i) {
+        printf("A %lu %lu %lu\n", i, Uniform(6), MIN_YEAR + Uniform(MAX_YEAR - MIN_YEAR + 1));
+    }
+    printf("D\n");
+    next_mid = movies;
+
+    for (i = 0; i < events; ) {
+        /* A burst of take-offs, rate / 1000 of the events in all */
+        if (Uniform(1000 * burst) < rate) {
+            for (b = 0; b < burst && i < events; ++b, ++i) printf("T %lu\n", ZipfNext(&movie_pop));
+            continue;
+        }
+
+        x = Uniform(total);
+        for (e = 0; x >= weights[e]; ++e) x -= weights[e];
+
+        switch (MIX_EVENTS[e]) {
+            case 'R': case 'U': case 'S':
+                printf("%c %lu\n", MIX_EVENTS[e], ZipfNext(&user_pop));
+                break;
+            case 'A':
+                printf("A %lu %lu %lu\n", next_mid++, Uniform(6), MIN_YEAR + Uniform(MAX_YEAR - MIN_YEAR + 1));
+                break;
+            case 'W':
+                printf("W %lu %lu\n", ZipfNext(&user_pop), ZipfNext(&movie_pop));
+                break;
+            case 'F':
+                printf("F %lu %lu %lu %lu\n", ZipfNext(&user_pop), Uniform(6), Uniform(6),
+                       MIN_YEAR + Uniform(MAX_YEAR - MIN_YEAR + 1));
+                break;
+            case 'Q':
+                printf("Q %lu %lu %lu\n", ZipfNext(&user_pop), Uniform(64),
+                       MIN_YEAR + Uniform(MAX_YEAR - MIN_YEAR + 1));
+                break;
+            default: /* D, M and P have no fields */
+                printf("%c\n", MIX_EVENTS[e]);
+                break;
+        }
+        ++i;
+    }
+
+    free(user_pop.cdf);
+    free(movie_pop.cdf);
+    return (fflush(stdout) == 0) ? 0 : EXIT_FAILURE;
+}
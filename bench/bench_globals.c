@@ -0,0 +1,19 @@
+/*
+ * Global variables of the service, defined in main.c, for the
+ * benchmarks that link streaming_service.c without main.c.
+*/
+#include "streaming_service.h"
+
+struct category_list category_array[6];
+struct new_movie* new_movies_list;
+struct new_movie* staged_movies;
+struct user* user_list;
+struct user* guard;
+struct hash_table user_index;
+struct hash_table movie_index;
+struct hash_table new_movie_index;
+struct hash_table suggestion_index;
+struct pool movie_pool;
+struct pool suggested_pool;
+struct pool new_movie_pool;
+struct pool user_pool;
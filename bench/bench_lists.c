@@ -0,0 +1,242 @@
+/*
+ * Cost of the list primitives of streaming_service.c, one at a time.
+ *
+ * Every primitive is driven n times on a structure that grows (or
+ * shrinks) to n elements, for each n given. The table gives the time
+ * and the number of malloc, calloc and realloc calls per operation,
+ * and the number of pool nodes each operation takes (negative when it
+ * gives them back). The calls to the allocator are counted by wrapping
+ * malloc, calloc and realloc at link time (GNU ld).
+ *
+ *   push, pop          watch stack: Push, then Pop
+ *   insert_lr          suggested list: one movie after the head and one before
+ *                      the tail in turn, where the two cursors of event S put them
+ *   insert_tail        suggested list: AppendSuggested of one movie
+ *   delete_sugg        SuggestedErase of random movies, which replaced the
+ *                      scan of RemoveFromSuggList
+ *   cat_append         CategoryReserve and CategoryMerge of one movie past
+ *                      the end, which replaced insert_end
+ *   cat_search         CategoryListSearch of random mids, half of them missing
+ *   stage_flush        NewMoviesStage in random order, then one NewMoviesFlush,
+ *                      which replaced the sorted insert of NewMoviesInsertSorted
+ *
+ * Build with: make bench
+ * Run:        ./bench/bench_lists [n ...]     (default 1000 10000 100000 1000000)
+*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "streaming_service.h"
+#include "streaming_internal.h"
+#include "cleaning_functions.h"
+
+/* Calls to the allocator, counted by the wrappers below */
+static unsigned long allocs = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    allocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    allocs++;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+    allocs++;
+    return __real_realloc(p, size);
+}
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Nodes of all pools in use */
+static long PoolNodes(void) {
+    return (long)(movie_pool.live + suggested_pool.live + new_movie_pool.live + user_pool.live);
+}
+
+/* Start and end of a measured loop of n operations */
+static double start_time;
+static unsigned long start_allocs;
+static long start_nodes;
+
+static void Start(void) {
+    start_allocs = allocs;
+    start_nodes = PoolNodes();
+    start_time = Now();
+}
+
+static void Stop(const char* name, unsigned n) {
+    double t = Now() - start_time;
+
+    printf("%-12s %9u %10.1f %12.4f %10.3f\n", name, n, t * 1e9 / n,
+           (double)(allocs - start_allocs) / n, (double)(PoolNodes() - start_nodes) / n);
+}
+
+/* Random permutation of 0..n-1 */
+static unsigned* Shuffled(unsigned n) {
+    unsigned* a = (unsigned*) malloc((n + 1) * sizeof(unsigned));
+    unsigned i, j, t;
+
+    if (a == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n; ++i) a[i] = i;
+    for (i = n; i > 1; --i) {
+        j = (unsigned)rand() % i;
+        t = a[i - 1];
+        a[i - 1] = a[j];
+        a[j] = t;
+    }
+
+    return a;
+}
+
+static void BenchStack(unsigned n) {
+    struct movie* S = NULL;
+    struct movie_info minfo;
+    unsigned i;
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        minfo.mid = i;
+        minfo.year = 2000;
+        Push(&S, minfo);
+    }
+    Stop("push", n);
+
+    Start();
+    for (i = 0; i < n; ++i) Pop(&S);
+    Stop("pop", n);
+}
+
+static void BenchSuggested(unsigned n, struct user* owner) {
+    struct sugg_segment* first;
+    struct movie_info minfo;
+    unsigned* order;
+    unsigned i, pos;
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        minfo.mid = i;
+        minfo.year = 2000;
+        if (i % 2 == 0) SuggestAround(owner, &minfo, 1, NULL, 0);
+        else SuggestAround(owner, NULL, 0, &minfo, 1);
+    }
+    Stop("insert_lr", n);
+    CleanSuggestedMovies(&owner->suggestedHead, &owner->suggestedTail);
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        minfo.mid = i;
+        minfo.year = 2000;
+        AppendSuggested(owner, &minfo, 1, &first, &pos);
+    }
+    Stop("insert_tail", n);
+
+    /* Delete the movies of the list just built in random order, found by mid */
+    order = Shuffled(n);
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        SuggestedErase((struct suggested_movie*) HashTableFind(&suggestion_index, order[i]), order[i]);
+    }
+    Stop("delete_sugg", n);
+
+    free(order);
+}
+
+static void BenchCategory(unsigned n) {
+    struct category_list* L = &category_array[0];
+    unsigned* order;
+    unsigned year = 2000;
+    unsigned i, mid;
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        mid = 2 * i;
+        if (CategoryReserve(L, L->size + 1) == 0) CategoryMerge(L, &mid, &year, 1);
+    }
+    Stop("cat_append", n);
+
+    /* Even mids are inside, odd ones are not */
+    order = Shuffled(n);
+    Start();
+    for (i = 0; i < n; ++i) CategoryListSearch(L, order[i]);
+    Stop("cat_search", n);
+    free(order);
+
+    CleanCategoryList(L);
+}
+
+static void BenchNewMovies(unsigned n) {
+    unsigned* order = Shuffled(n);
+    unsigned i;
+
+    Start();
+    for (i = 0; i < n; ++i) {
+        NewMoviesStage(order[i], (movieCategory_t)(order[i] % 6), 1950 + order[i] % 75);
+    }
+    NewMoviesFlush();
+    Stop("stage_flush", n);
+
+    CleanNewMoviesList(&new_movies_list);
+    free(order);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned defaults[] = {1000, 10000, 100000, 1000000};
+    struct user owner;
+    unsigned n;
+    int i, count;
+
+    srand(240);
+    PoolInit(&movie_pool, "movie", sizeof(struct movie));
+    PoolInit(&suggested_pool, "sugg_segment", sizeof(struct sugg_segment));
+    PoolInit(&new_movie_pool, "new_movie", sizeof(struct new_movie));
+    PoolInit(&user_pool, "user", sizeof(struct user));
+    HashTableInit(&movie_index, 64);
+    HashTableInit(&new_movie_index, 64);
+    HashTableInit(&suggestion_index, 64);
+
+    owner.uid = 0;
+    owner.order = 1;
+    owner.suggestedHead = owner.suggestedTail = NULL;
+    MidSetInit(&owner.suggestedSet);
+    owner.watchHistory = NULL;
+    owner.prev = owner.next = NULL;
+
+    printf("%-12s %9s %10s %12s %10s\n", "primitive", "n", "ns/op", "mallocs/op", "nodes/op");
+
+    count = (argc > 1) ? argc - 1 : (int)(sizeof(defaults) / sizeof(defaults[0]));
+    for (i = 0; i < count; ++i) {
+        n = (argc > 1) ? (unsigned)strtoul(argv[i + 1], NULL, 10) : defaults[i];
+        if (n == 0) continue;
+
+        BenchStack(n);
+        BenchSuggested(n, &owner);
+        BenchCategory(n);
+        BenchNewMovies(n);
+        printf("\n");
+    }
+
+    HashTableDestroy(&movie_index);
+    HashTableDestroy(&new_movie_index);
+    HashTableDestroy(&suggestion_index);
+    PoolDestroy(&movie_pool);
+    PoolDestroy(&suggested_pool);
+    PoolDestroy(&new_movie_pool);
+    PoolDestroy(&user_pool);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Lines per second of the two ways to read the event file.
+ *
+ * A random event file is written, then parsed by the fgets + sscanf
+ * loop main.c used to have and by the event parser, which maps the
+ * file to memory. The events are not executed. Both must give the
+ * same events, which is checked with a checksum of their fields.
+ *
+ * Build with: make bench
+ * Run:        ./bench/bench_parser [lines] [file]
+*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "event_parser.h"
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Mix of the fields of ev, so that both parsers can be compared */
+static unsigned long Checksum(unsigned long sum, const struct event* ev) {
+    sum = sum * 31 + (unsigned char)ev->type;
+    sum = sum * 31 + (unsigned)ev->status;
+    if (ev->status != EVENT_OK) return sum;
+
+    switch (ev->type) {
+        case 'R': case 'U': case 'S':
+            return sum * 31 + (unsigned)ev->uid;
+        case 'A':
+            return (sum * 31 + ev->mid) * 31 + (unsigned)ev->category1 + ev->year;
+        case 'W':
+            return (sum * 31 + (unsigned)ev->uid) * 31 + ev->mid;
+        case 'F':
+            return ((sum * 31 + (unsigned)ev->uid) * 31 + (unsigned)ev->category1) * 31
+                   + (unsigned)ev->category2 + ev->year;
+        case 'Q':
+            return ((sum * 31 + (unsigned)ev->uid) * 31 + ev->mask) * 31 + ev->year;
+        case 'T':
+            return sum * 31 + ev->mid;
+    }
+    return sum;
+}
+
+/* Write lines random events to path, in the proportions of a busy service */
+static int WriteEvents(const char* path, unsigned long lines) {
+    FILE* f = fopen(path, "w");
+    unsigned long i;
+    int x;
+
+    if (f == NULL) return -1;
+
+    srand(240);
+    for (i = 0; i < lines; ++i) {
+        x = rand() % 100;
+        if (x < 40) fprintf(f, "W %d %d\n", rand() % 100000, rand() % 1000000);
+        else if (x < 60) fprintf(f, "A %d %d %d\n", rand() % 1000000, rand() % 6, 1950 + rand() % 75);
+        else if (x < 70) fprintf(f, "S %d\n", rand() % 100000);
+        else if (x < 78) fprintf(f, "F %d %d %d %d\n", rand() % 100000, rand() % 6, rand() % 6, 1950 + rand() % 75);
+        else if (x < 82) fprintf(f, "Q %d %d %d\n", rand() % 100000, rand() % 64, 1950 + rand() % 75);
+        else if (x < 88) fprintf(f, "T %d\n", rand() % 1000000);
+        else if (x < 94) fprintf(f, "R %d\n", rand() % 100000);
+        else if (x < 97) fprintf(f, "U %d\n", rand() % 100000);
+        else if (x < 98) fprintf(f, "D\n");
+        else fprintf(f, "# comment line\n");
+    }
+
+    return fclose(f);
+}
+
+int main(int argc, char* argv[]) {
+    unsigned long lines = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000000UL;
+    const char* path = (argc > 2) ? argv[2] : "bench_parser_events.txt";
+    char line_buffer[MAX_LINE];
+    struct event_parser parser;
+    struct event ev;
+    unsigned long n, sum_stdio = 0, sum_mmap = 0;
+    FILE* f;
+    double t;
+
+    if (WriteEvents(path, lines) != 0) {
+        perror("Could not write the event file");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-14s %10s %14s\n", "parser", "lines", "Mlines/s");
+
+    /* The loop main.c had before the event parser */
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror("fopen error for event file open");
+        return EXIT_FAILURE;
+    }
+    t = Now();
+    for (n = 0; fgets(line_buffer, MAX_LINE, f); ++n) {
+        EventParseLine(line_buffer, &ev);
+        sum_stdio = Checksum(sum_stdio, &ev);
+    }
+    t = Now() - t;
+    fclose(f);
+    printf("%-14s %10lu %14.2f\n", "fgets+sscanf", n, n / t / 1e6);
+
+    t = Now();
+    if (EventParserOpen(&parser, path) == -1) {
+        perror("Could not map the event file");
+        return EXIT_FAILURE;
+    }
+    for (n = 0; EventParserNext(&parser, &ev); ++n) {
+        sum_mmap = Checksum(sum_mmap, &ev);
+    }
+    EventParserClose(&parser);
+    t = Now() - t;
+    printf("%-14s %10lu %14.2f\n", "mmap", n, n / t / 1e6);
+
+    remove(path);
+
+    if (sum_stdio != sum_mmap) {
+        fprintf(stderr, "The parsers give different events\n");
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# Replay throughput of text and binary event files.
+#
+# test_files/test_U50M100 is scaled up by concatenating copies of it,
+# the ids of copy k shifted by k * 100 (users) and k * 1000 (movies).
+# M and P are left out, as they print every structure, and every copy
+# ends by unregistering its users. The scaled file is converted to the
+# binary format and both are replayed by cs240StreamingService.
+#
+# Build with: make all
+# Run:        sh bench/bench_replay.sh [copies]
+#
+COPIES=${1:-200}
+DIR=$(mktemp -d)
+TEXT=$DIR/events.txt
+BIN=$DIR/events.bin
+
+awk -v copies="$COPIES" '
+    NR == FNR { line[n++] = $0; next }
+    END {
+        for (k = 0; k < copies; ++k) {
+            u = k * 100; m = k * 1000
+            for (i = 0; i < n; ++i) {
+                split(line[i], f, " ")
+                e = f[1]
+                if (e == "R" || e == "U" || e == "S") print e, f[2] + u
+                else if (e == "A") print e, f[2] + m, f[3], f[4]
+                else if (e == "W") print e, f[2] + u, f[3] + m
+                else if (e == "F") print e, f[2] + u, f[3], f[4], f[5]
+                else if (e == "T") print e, f[2] + m
+                else if (e == "D") print e
+            }
+            for (i = 0; i < 50; ++i) print "U", i + u
+        }
+    }' test_files/test_U50M100 /dev/null > "$TEXT"
+
+./cs240EventConvert "$TEXT" "$BIN" || exit 1
+EVENTS=$(wc -l < "$TEXT")
+
+# Seconds taken by the command given
+elapsed() {
+    start=$(date +%s.%N)
+    "$@" > /dev/null 2>&1
+    end=$(date +%s.%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { print e - s }'
+}
+
+printf "%-8s %-8s %10s %12s\n" format output seconds Mevents/s
+for output in status full; do
+    for format in text binary; do
+        if [ $format = text ]; then file=$TEXT; else file=$BIN; fi
+        t=$(elapsed ./cs240StreamingService --output=$output "$file")
+        awk -v f=$format -v o=$output -v t="$t" -v n="$EVENTS" \
+            'BEGIN { printf "%-8s %-8s %10.3f %12.2f\n", f, o, t, n / t / 1e6 }'
+    done
+done
+
+rm -rf "$DIR"
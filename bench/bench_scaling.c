@@ -0,0 +1,239 @@
+/*
+ * End-to-end scaling of cs240StreamingService on synthetic workloads.
+ *
+ * For every scale k given, bench_gen writes an event file of 1000 k
+ * users, 10000 k movies and 20000 k events, which the service binary
+ * then executes. The table printed gives the events per second and
+ * the peak resident set of each run, so that the curves of two builds
+ * can be compared by running this once with each binary.
+ *
+ * When the binary is built with -DEVENT_STATS (see event_stats.h), a
+ * second table gives the mean cost of each event type at every scale.
+ *
+ * Build with: make all bench
+ * Run:        ./bench/bench_scaling [options] [scale ...]     (default 1 2 4)
+ *   -b binary     service binary (./cs240StreamingService)
+ *   -g generator  generator binary (./bench/bench_gen)
+ *   -o output     output mode of the service (status)
+ *   -x mix, -z exponent, -t rate, -s seed
+ *                 passed to the generator, see bench_gen.c
+*/
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_SCALES 32
+#define MAX_ARGS 32
+
+/* Event types of the cost table, in the order of the columns */
+#define COST_EVENTS "RUADWSFQTMPI"
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * Run argv with stdout to the file out and stderr to the file err.
+ * ru gets the resources it used. Returns 0 if it exited with 0, -1 otherwise.
+*/
+static int Run(char* const argv[], const char* out, const char* err, struct rusage* ru) {
+    pid_t pid;
+    int status, fd;
+
+    pid = fork();
+    if (pid == -1) return -1;
+
+    if (pid == 0) {
+        fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1 || dup2(fd, STDOUT_FILENO) == -1) _exit(127);
+        close(fd);
+        fd = open(err, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1 || dup2(fd, STDERR_FILENO) == -1) _exit(127);
+        close(fd);
+
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    if (wait4(pid, &status, 0, ru) == -1) return -1;
+    return (WIFEXITED(status) && WEXITSTATUS(status) == 0) ? 0 : -1;
+}
+
+/* Number of lines of the file path */
+static unsigned long CountLines(const char* path) {
+    FILE* f = fopen(path, "r");
+    unsigned long lines = 0;
+    int c;
+
+    if (f == NULL) return 0;
+    while ((c = getc(f)) != EOF) lines += (c == '\n');
+    fclose(f);
+
+    return lines;
+}
+
+/*
+ * Read the mean cost of each event type from the event stats report
+ * in the file path to mean, indexed as COST_EVENTS (0 if not seen).
+ * Returns 0 if the file has a report, -1 otherwise.
+*/
+static int ReadCosts(const char* path, unsigned long mean[]) {
+    FILE* f = fopen(path, "r");
+    char line[256];
+    const char* p;
+    unsigned long count, misses, m;
+    char type;
+    int found = 0;
+
+    memset(mean, 0, strlen(COST_EVENTS) * sizeof(unsigned long));
+    if (f == NULL) return -1;
+
+    while (fgets(line, sizeof(line), f)) {
+        if (!found) {
+            found = (strncmp(line, "Event latency (ns)", 18) == 0);
+            continue;
+        }
+        if (sscanf(line, " %c %lu %lu %lu", &type, &count, &misses, &m) != 4) continue;
+        p = strchr(COST_EVENTS, type);
+        if (p != NULL) mean[p - COST_EVENTS] = m;
+    }
+    fclose(f);
+
+    return found ? 0 : -1;
+}
+
+static void Usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-b binary] [-g generator] [-o output] [-x mix] [-z exponent]\n"
+                    "          [-t rate] [-s seed] [scale ...]\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char* argv[]) {
+    const char* binary = "./cs240StreamingService";
+    const char* generator = "./bench/bench_gen";
+    const char* output = "status";
+    char* gen_opts[8];
+    unsigned ngen_opts = 0;
+    unsigned long scales[MAX_SCALES];
+    unsigned long costs[MAX_SCALES][sizeof(COST_EVENTS) - 1];
+    int have_costs = 0;
+    int failed = 0;
+    unsigned nscales = 0;
+    char dir[] = "/tmp/bench_scaling_XXXXXX";
+    char events[64], err[64];
+    char users_arg[32], movies_arg[32], events_arg[32], output_arg[32];
+    char* args[MAX_ARGS];
+    struct rusage ru;
+    unsigned long lines;
+    unsigned i, j, n;
+    double t;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:g:o:x:z:t:s:")) != -1) {
+        switch (opt) {
+            case 'b': binary = optarg; break;
+            case 'g': generator = optarg; break;
+            case 'o': output = optarg; break;
+            case 'x': case 'z': case 't': case 's':
+                if (ngen_opts == 8) Usage(argv[0]);
+                gen_opts[ngen_opts++] = (opt == 'x') ? "-x" : (opt == 'z') ? "-z" : (opt == 't') ? "-t" : "-s";
+                gen_opts[ngen_opts++] = optarg;
+                break;
+            default: Usage(argv[0]);
+        }
+    }
+    for (; optind < argc && nscales < MAX_SCALES; ++optind) {
+        scales[nscales] = strtoul(argv[optind], NULL, 10);
+        if (scales[nscales] == 0) Usage(argv[0]);
+        nscales++;
+    }
+    if (nscales == 0) {
+        for (i = 0; i < 3; ++i) scales[nscales++] = 1UL << i;
+    }
+
+    if (mkdtemp(dir) == NULL) {
+        perror("Could not make a temporary directory");
+        return EXIT_FAILURE;
+    }
+    sprintf(events, "%s/events.txt", dir);
+    sprintf(err, "%s/err.txt", dir);
+    sprintf(output_arg, "--output=%s", output);
+
+    printf("%6s %8s %9s %10s %9s %12s %10s\n",
+           "scale", "users", "movies", "events", "seconds", "events/s", "peak MiB");
+
+    for (i = 0; i < nscales; ++i) {
+        sprintf(users_arg, "%lu", 1000 * scales[i]);
+        sprintf(movies_arg, "%lu", 10000 * scales[i]);
+        sprintf(events_arg, "%lu", 20000 * scales[i]);
+
+        n = 0;
+        args[n++] = (char*) generator;
+        args[n++] = "-u";
+        args[n++] = users_arg;
+        args[n++] = "-m";
+        args[n++] = movies_arg;
+        args[n++] = "-e";
+        args[n++] = events_arg;
+        for (j = 0; j < ngen_opts; ++j) args[n++] = gen_opts[j];
+        args[n] = NULL;
+        if (Run(args, events, err, &ru) == -1) {
+            fprintf(stderr, "%s failed, see %s\n", generator, err);
+            failed = 1;
+            break;
+        }
+        lines = CountLines(events);
+
+        n = 0;
+        args[n++] = (char*) binary;
+        args[n++] = output_arg;
+        args[n++] = events;
+        args[n] = NULL;
+        t = Now();
+        if (Run(args, "/dev/null", err, &ru) == -1) {
+            fprintf(stderr, "%s failed, see %s\n", binary, err);
+            failed = 1;
+            break;
+        }
+        t = Now() - t;
+
+        printf("%6lu %8s %9s %10lu %9.3f %12.0f %10.1f\n", scales[i], users_arg, movies_arg,
+               lines, t, lines / t, ru.ru_maxrss / 1024.0);
+        fflush(stdout);
+
+        if (ReadCosts(err, costs[i]) == 0) have_costs = 1;
+    }
+    nscales = i;
+
+    if (have_costs) {
+        printf("\nMean ns per event\n%6s", "scale");
+        for (j = 0; COST_EVENTS[j] != '\0'; ++j) printf(" %8c", COST_EVENTS[j]);
+        printf("\n");
+        for (i = 0; i < nscales; ++i) {
+            printf("%6lu", scales[i]);
+            for (j = 0; COST_EVENTS[j] != '\0'; ++j) printf(" %8lu", costs[i][j]);
+            printf("\n");
+        }
+    }
+    else {
+        printf("\nBuild the binary with -DEVENT_STATS for the cost of each event type\n");
+    }
+
+    /* The files of a failed run are kept */
+    if (failed) return EXIT_FAILURE;
+
+    remove(events);
+    remove(err);
+    rmdir(dir);
+    return 0;
+}
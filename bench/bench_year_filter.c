@@ -0,0 +1,106 @@
+/*
+ * Throughput of the year filter kernels of event F.
+ *
+ * For several list sizes and year cutoffs, a random years column is
+ * filtered by every kernel the CPU supports, and by the branchy loop
+ * filtered_movie_search used before the kernels. The positions written
+ * by each kernel are checked against the scalar one.
+ *
+ * Build with: make bench
+ * Run:        ./bench/bench_year_filter [total_elements]
+*/
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "year_filter.h"
+
+#define MIN_YEAR 1950
+#define MAX_YEAR 2024
+
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The check filtered_movie_search used to do movie by movie */
+static unsigned FilterBranchy(const unsigned* years, unsigned n,
+                              unsigned year, unsigned* out) {
+    unsigned i, k = 0;
+    for (i = 0; i < n; ++i) {
+        if (years[i] < year) continue;
+        out[k++] = i;
+    }
+    return k;
+}
+
+int main(int argc, char* argv[]) {
+    const char* kernels[] = {"branchy", "scalar", "sse2", "avx2"};
+    const unsigned sizes[] = {1000, 100000, 1000000};
+    const unsigned cutoffs[] = {MIN_YEAR, 1990, 2020};
+    unsigned long total = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000000UL;
+    unsigned* years;
+    unsigned* expected;
+    unsigned* out;
+    unsigned n, year, count, expected_count, reps, r, i;
+    size_t s, c, k;
+    double t, checksum = 0;
+
+    years = (unsigned*) malloc(sizes[2] * sizeof(unsigned));
+    expected = (unsigned*) malloc(sizes[2] * sizeof(unsigned));
+    out = (unsigned*) malloc(sizes[2] * sizeof(unsigned));
+    if (years == NULL || expected == NULL || out == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return EXIT_FAILURE;
+    }
+
+    srand(240);
+    for (i = 0; i < sizes[2]; ++i) {
+        years[i] = MIN_YEAR + (unsigned)rand() % (MAX_YEAR - MIN_YEAR + 1);
+    }
+
+    printf("%-8s %9s %6s %9s %12s\n", "kernel", "n", "year", "passing", "Melem/s");
+
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        n = sizes[s];
+        reps = (unsigned)(total / n);
+        if (reps == 0) reps = 1;
+
+        for (c = 0; c < sizeof(cutoffs) / sizeof(cutoffs[0]); ++c) {
+            year = cutoffs[c];
+
+            YearFilterSelect("scalar");
+            expected_count = YearFilter(years, n, year, expected);
+
+            for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+                if (k > 0 && YearFilterSelect(kernels[k]) == -1) continue;
+
+                t = Now();
+                for (r = 0; r < reps; ++r) {
+                    count = (k == 0) ? FilterBranchy(years, n, year, out)
+                                     : YearFilter(years, n, year, out);
+                    checksum += out[count / 2];
+                }
+                t = Now() - t;
+
+                if (count != expected_count ||
+                    memcmp(out, expected, count * sizeof(unsigned)) != 0) {
+                    fprintf(stderr, "%s kernel gives wrong positions\n", kernels[k]);
+                    return EXIT_FAILURE;
+                }
+
+                printf("%-8s %9u %6u %9u %12.1f\n", kernels[k], n, year, count,
+                       (double)n * reps / t / 1e6);
+            }
+        }
+    }
+
+    fprintf(stderr, "(checksum %.0f)\n", checksum);
+    free(years);
+    free(expected);
+    free(out);
+    return 0;
+}
@@ -7,14 +7,14 @@
 
 #include "streaming_service.h"
 
-/* Deallocate all nodes from the suggested movie list given */
-void CleanSuggestedMovies(struct suggested_movie** head, struct suggested_movie** tail);
+/* Deallocate all segments from the suggested movie list given */
+void CleanSuggestedMovies(struct sugg_segment** head, struct sugg_segment** tail);
 
 /* Deallocate all stack nodes and the stack. */
 void CleanStack(struct movie** S);
 
-/* Deallocate all nodes of the category list given */
-void CleanCategoryList(struct movie** L);
+/* Deallocate the category list given and the movie_index entries of its movies */
+void CleanCategoryList(struct category_list* L);
 
 /* Deallocate all nodes of the new movies list given */
 void CleanNewMoviesList(struct new_movie** L);
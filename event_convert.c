@@ -0,0 +1,65 @@
+/*
+ * Converter from text event files, like the ones in test_files,
+ * to the binary event format described in event_parser.h.
+ * cs240StreamingService tells the two formats apart by itself.
+ *
+ * Usage: cs240EventConvert <text_event_file> <binary_event_file>
+*/
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "event_parser.h"
+
+int main(int argc, char *argv[])
+{
+	struct event_parser parser;
+	struct event ev;
+	unsigned char header[EVENT_HEADER_SIZE];
+	unsigned char record[EVENT_RECORD_SIZE];
+	unsigned long records = 0;
+	FILE *out;
+	int code;
+
+	if (argc != 3) {
+		fprintf(stderr, "Usage: %s <text_event_file> <binary_event_file>\n",
+				argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	code = EventParserOpen(&parser, argv[1]);
+	if (code == -1)
+		perror("open error for text event file");
+	if (code != 0)
+		return EXIT_FAILURE;
+	if (parser.binary) {
+		fprintf(stderr, "%s is already a binary event file\n", argv[1]);
+		EventParserClose(&parser);
+		return EXIT_FAILURE;
+	}
+
+	out = fopen(argv[2], "wb");
+	if (!out) {
+		perror("fopen error for binary event file");
+		EventParserClose(&parser);
+		return EXIT_FAILURE;
+	}
+
+	/* One record for every line, comments are dropped */
+	EventBinaryHeader(header);
+	fwrite(header, 1, EVENT_HEADER_SIZE, out);
+	while (EventParserNext(&parser, &ev)) {
+		if (EventBinaryRecord(&ev, record) == -1)
+			continue;
+		fwrite(record, 1, EVENT_RECORD_SIZE, out);
+		records++;
+	}
+	EventParserClose(&parser);
+
+	if (ferror(out) | fclose(out)) {
+		perror("write error for binary event file");
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "%lu events written to %s\n", records, argv[2]);
+	return 0;
+}
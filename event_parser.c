@@ -0,0 +1,352 @@
+/*
+ * Function definitions for the event parsing declared in event_parser.h.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <ctype.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "event_parser.h"
+
+/* Whitespace as isspace() sees it in the "C" locale */
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/* Number of fields and their conversions for each event type, "" for none */
+static const char* Fields(char type) {
+    switch (type) {
+        case 'R': case 'U': return "d";
+        case 'S': return "d";
+        case 'A': return "udu";
+        case 'W': return "du";
+        case 'F': return "dddu";
+        case 'Q': return "duu";
+        case 'T': return "u";
+        default: return "";
+    }
+}
+
+/* Returns the n-th field (in Fields() order) of event ev */
+static unsigned long GetField(const struct event* ev, int n) {
+    switch (ev->type) {
+        case 'R': case 'U': case 'S':
+            return (unsigned)ev->uid;
+        case 'A':
+            return (n == 0) ? ev->mid : (n == 1) ? (unsigned)ev->category1 : ev->year;
+        case 'W':
+            return (n == 0) ? (unsigned)ev->uid : ev->mid;
+        case 'F':
+            return (n == 0) ? (unsigned)ev->uid : (n == 1) ? (unsigned)ev->category1 :
+                   (n == 2) ? (unsigned)ev->category2 : ev->year;
+        case 'Q':
+            return (n == 0) ? (unsigned)ev->uid : (n == 1) ? ev->mask : ev->year;
+        case 'T':
+            return ev->mid;
+    }
+    return 0;
+}
+
+/* Store the n-th field (in Fields() order) of an event of type type */
+static void SetField(struct event* ev, int n, unsigned long value) {
+    switch (ev->type) {
+        case 'R': case 'U': case 'S':
+            ev->uid = (int)value;
+            break;
+        case 'A':
+            if (n == 0) ev->mid = (unsigned)value;
+            else if (n == 1) ev->category1 = (int)value;
+            else ev->year = (unsigned)value;
+            break;
+        case 'W':
+            if (n == 0) ev->uid = (int)value;
+            else ev->mid = (unsigned)value;
+            break;
+        case 'F':
+            if (n == 0) ev->uid = (int)value;
+            else if (n == 1) ev->category1 = (int)value;
+            else if (n == 2) ev->category2 = (int)value;
+            else ev->year = (unsigned)value;
+            break;
+        case 'Q':
+            if (n == 0) ev->uid = (int)value;
+            else if (n == 1) ev->mask = (unsigned)value;
+            else ev->year = (unsigned)value;
+            break;
+        case 'T':
+            ev->mid = (unsigned)value;
+            break;
+    }
+}
+
+void EventParseLine(const char* line, struct event* ev) {
+    const char* trimmed_line = line;
+
+    /* First trim any whitespace leading the line. */
+    while (isspace((unsigned char)*trimmed_line)) trimmed_line++;
+
+    ev->line = trimmed_line;
+    ev->line_len = strlen(trimmed_line);
+    ev->status = EVENT_OK;
+
+    /* Find the event, or comment starting with # */
+    if (sscanf(trimmed_line, "%c", &ev->type) != 1) {
+        ev->type = '\0';
+        ev->status = EVENT_NO_TYPE;
+        return;
+    }
+
+    switch (ev->type) {
+        case 'R':
+            if (sscanf(trimmed_line, "R %d", &ev->uid) != 1) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'U':
+            if (sscanf(trimmed_line, "U %d", &ev->uid) != 1) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'A':
+            if (sscanf(trimmed_line, "A %u %d %u", &ev->mid, &ev->category1,
+                       &ev->year) != 3) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'W':
+            if (sscanf(trimmed_line, "W %d %u", &ev->uid, &ev->mid) != 2) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'S':
+            if (sscanf(trimmed_line, "S %d", &ev->uid) != 1) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'F':
+            if (sscanf(trimmed_line, "F %d %d %d %u", &ev->uid, &ev->category1,
+                       &ev->category2, &ev->year) != 4) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'Q':
+            if (sscanf(trimmed_line, "Q %d %u %u", &ev->uid, &ev->mask,
+                       &ev->year) != 3) ev->status = EVENT_PARSE_ERROR;
+            break;
+        case 'T':
+            if (sscanf(trimmed_line, "T %u", &ev->mid) != 1) ev->status = EVENT_PARSE_ERROR;
+            break;
+    }
+}
+
+int EventParserOpen(struct event_parser* P, const char* path) {
+    struct stat st;
+    void* data;
+    int fd;
+
+    P->data = NULL;
+    P->size = 0;
+    P->pos = 0;
+    P->mapped = P->binary = 0;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    /* An empty file can not be mapped and has no events */
+    if (st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    posix_madvise(data, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    if (EventParserInit(P, (const char*)data, (size_t)st.st_size) == -1) {
+        munmap(data, (size_t)st.st_size);
+        return -2;
+    }
+    P->mapped = 1;
+    return 0;
+}
+
+/* Little endian 32 bit number at p */
+static unsigned long Load32(const unsigned char* p) {
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8) |
+           ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void Store32(unsigned char* p, unsigned long v) {
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+    p[3] = (unsigned char)((v >> 24) & 0xFF);
+}
+
+int EventParserInit(struct event_parser* P, const char* data, size_t size) {
+    const unsigned char* header = (const unsigned char*) data;
+
+    P->data = data;
+    P->size = size;
+    P->pos = 0;
+    P->mapped = 0;
+    P->binary = 0;
+
+    if (size < EVENT_BINARY_MAGIC_SIZE ||
+        memcmp(data, EVENT_BINARY_MAGIC, EVENT_BINARY_MAGIC_SIZE) != 0) {
+        return 0; /* Text event file */
+    }
+
+    if (size < EVENT_HEADER_SIZE || Load32(header + 8) != EVENT_BINARY_VERSION ||
+        Load32(header + 12) != EVENT_RECORD_SIZE) {
+        fprintf(stderr, "Binary event file of unknown version\n");
+        return -1;
+    }
+    if ((size - EVENT_HEADER_SIZE) % EVENT_RECORD_SIZE != 0) {
+        fprintf(stderr, "Binary event file ends in the middle of a record\n");
+        return -1;
+    }
+
+    P->binary = 1;
+    P->pos = EVENT_HEADER_SIZE;
+    return 0;
+}
+
+void EventParserClose(struct event_parser* P) {
+    if (P->mapped) munmap((void*)P->data, P->size);
+    P->data = NULL;
+    P->size = P->pos = 0;
+    P->mapped = P->binary = 0;
+}
+
+void EventBinaryHeader(unsigned char out[EVENT_HEADER_SIZE]) {
+    memcpy(out, EVENT_BINARY_MAGIC, EVENT_BINARY_MAGIC_SIZE);
+    Store32(out + 8, EVENT_BINARY_VERSION);
+    Store32(out + 12, EVENT_RECORD_SIZE);
+}
+
+int EventBinaryRecord(const struct event* ev, unsigned char out[EVENT_RECORD_SIZE]) {
+    const char* fields = Fields(ev->type);
+    int n;
+
+    if (ev->type == '#' && ev->status == EVENT_OK) return -1;
+
+    memset(out, 0, EVENT_RECORD_SIZE);
+    out[0] = (unsigned char)ev->type;
+    out[1] = (unsigned char)ev->status;
+
+    /* The fields of an event with a parse error are not used */
+    if (ev->status == EVENT_OK) {
+        for (n = 0; fields[n] != '\0'; ++n) Store32(out + 4 + 4 * n, GetField(ev, n));
+    }
+
+    return 0;
+}
+
+/* Decode the record at rec to ev */
+static void DecodeRecord(const unsigned char* rec, struct event* ev) {
+    const char* fields;
+    int n;
+
+    ev->type = (char)rec[0];
+    ev->status = (enum event_status)rec[1];
+    ev->line = "";
+    ev->line_len = 0;
+
+    fields = Fields(ev->type);
+    for (n = 0; fields[n] != '\0'; ++n) SetField(ev, n, Load32(rec + 4 + 4 * n));
+}
+
+/*
+ * Scan a number of [*s, end) as the %d (is_signed) or %u conversions of
+ * sscanf do: optional sign then decimal digits, saturated like strtol/strtoul.
+ * Returns 0 and advances *s on success, -1 if there is no number.
+*/
+static int ScanNumber(const char** s, const char* end, int is_signed, unsigned long* value) {
+    const char* p = *s;
+    unsigned long v = 0;
+    int negative = 0;
+    int overflow = 0;
+    unsigned d;
+
+    if (p < end && (*p == '+' || *p == '-')) negative = (*p++ == '-');
+    if (p == end || (unsigned)(*p - '0') > 9) return -1;
+
+    for (; p < end && (d = (unsigned)(*p - '0')) <= 9; ++p) {
+        if (v > (ULONG_MAX - d) / 10) overflow = 1;
+        v = v * 10 + d;
+    }
+
+    if (is_signed) {
+        if (negative) {
+            if (overflow || v > (unsigned long)LONG_MAX + 1) v = (unsigned long)LONG_MIN;
+            else v = -v;
+        }
+        else if (overflow || v > (unsigned long)LONG_MAX) v = LONG_MAX;
+    }
+    else {
+        if (overflow) v = ULONG_MAX;
+        else if (negative) v = -v;
+    }
+
+    *s = p;
+    *value = v;
+    return 0;
+}
+
+int EventParserNext(struct event_parser* P, struct event* ev) {
+    const char* p;
+    const char* end;
+    const char* nl;
+    const char* nul;
+    const char* fields;
+    unsigned long value;
+    size_t len;
+    int n;
+
+    if (P->pos >= P->size) return 0;
+
+    if (P->binary) {
+        DecodeRecord((const unsigned char*)P->data + P->pos, ev);
+        P->pos += EVENT_RECORD_SIZE;
+        return 1;
+    }
+
+    /* The line fgets would read: up to the newline, at most MAX_LINE - 1 bytes */
+    p = P->data + P->pos;
+    len = P->size - P->pos;
+    if (len > MAX_LINE - 1) len = MAX_LINE - 1;
+    nl = (const char*) memchr(p, '\n', len);
+    if (nl != NULL) len = (size_t)(nl - p) + 1;
+    P->pos += len;
+
+    /* sscanf stops at a '\0' inside the line */
+    end = p + len;
+    nul = (const char*) memchr(p, '\0', len);
+    if (nul != NULL) end = nul;
+
+    /* Trim any whitespace leading the line */
+    while (p < end && IS_SPACE(*p)) p++;
+
+    ev->line = p;
+    ev->line_len = (size_t)(end - p);
+    ev->status = EVENT_OK;
+
+    if (p == end) {
+        ev->type = '\0';
+        ev->status = EVENT_NO_TYPE;
+        return 1;
+    }
+    ev->type = *p++;
+
+    /* Whitespace, then a number, for every field */
+    fields = Fields(ev->type);
+    for (n = 0; fields[n] != '\0'; ++n) {
+        while (p < end && IS_SPACE(*p)) p++;
+        if (ScanNumber(&p, end, fields[n] == 'd', &value) == -1) {
+            ev->status = EVENT_PARSE_ERROR;
+            break;
+        }
+        SetField(ev, n, value);
+    }
+
+    return 1;
+}
@@ -0,0 +1,112 @@
+/*
+ * Event file parsing.
+ *
+ * Every line of the event file becomes a struct event, which main.c
+ * executes. There are two ways to get the events:
+ *  - EventParseLine() takes a line read by fgets and parses it with sscanf.
+ *  - The event parser maps the whole event file to memory and scans
+ *    it in place with a hand written integer scanner, no copies and no
+ *    stdio. It gives the same events, errors included: lines are cut
+ *    at MAX_LINE - 1 bytes like fgets does, and numbers are converted
+ *    like the %d and %u conversions of sscanf.
+ *
+ * The event parser also reads binary event files, told apart by their
+ * magic. A binary event file is a header followed by fixed width records,
+ * one for each line of the text file it was converted from (comments
+ * are dropped). All numbers are little endian:
+ *
+ *   header  8 bytes  EVENT_BINARY_MAGIC
+ *           4 bytes  format version, EVENT_BINARY_VERSION
+ *           4 bytes  record size, EVENT_RECORD_SIZE
+ *   record  1 byte   event type letter
+ *           1 byte   enum event_status
+ *           2 bytes  zero
+ *           4 x 4    the fields of the event in the order of its text form:
+ *                    R, U, S: uid   A: mid category year   W: uid mid
+ *                    F: uid category1 category2 year   Q: uid mask year
+ *                    T: mid         the rest: none (unused fields are zero)
+*/
+#ifndef EVENT_PARSER_H
+#define EVENT_PARSER_H
+
+#include <stddef.h>
+
+/* Maximum input line size, including the terminating '\0' of fgets */
+#define MAX_LINE 1024
+
+enum event_status {
+    EVENT_OK,           /* The fields of the event are valid */
+    EVENT_PARSE_ERROR,  /* The event type is known, its fields could not be parsed */
+    EVENT_NO_TYPE       /* Blank line, there is no event type */
+};
+
+struct event {
+    char type;                  /* Event letter, '#' for comments */
+    enum event_status status;
+    int uid;
+    unsigned mid;
+    unsigned year;
+    unsigned mask;
+    int category1;
+    int category2;
+    const char* line;           /* The line without its leading whitespace, */
+    size_t line_len;            /* not '\0' terminated */
+};
+
+/* Binary event file format, see above */
+#define EVENT_BINARY_MAGIC "\211CS240EV"
+#define EVENT_BINARY_MAGIC_SIZE 8
+#define EVENT_BINARY_VERSION 1
+#define EVENT_HEADER_SIZE 16
+#define EVENT_RECORD_SIZE 20
+
+/* Event file mapped to memory */
+struct event_parser {
+    const char* data;
+    size_t size;
+    size_t pos;                 /* Start of the next line or record */
+    int mapped;                 /* Set if data was mapped by EventParserOpen */
+    int binary;                 /* Set for a binary event file */
+};
+
+/*
+ * Parse line, read by fgets, to ev with sscanf.
+ * ev->line points into line.
+*/
+void EventParseLine(const char* line, struct event* ev);
+
+/*
+ * Map the event file path to memory, text or binary.
+ * Returns 0 on success, -1 if the file could not be opened or mapped
+ * (errno tells why) and -2 for a bad binary event file (reported to stderr).
+*/
+int EventParserOpen(struct event_parser* P, const char* path);
+
+/*
+ * Parser over the size bytes of data, which are not copied
+ * and must not change while the parser is used.
+ * Returns 0 on success, -1 if data is a binary event file
+ * with an unknown version or a truncated record.
+*/
+int EventParserInit(struct event_parser* P, const char* data, size_t size);
+
+/*
+ * Parse the next line, or decode the next record, of the event file to ev.
+ * ev->line points into the mapped file (empty for a binary file).
+ * Returns 1 if an event was read, 0 at the end of the file.
+*/
+int EventParserNext(struct event_parser* P, struct event* ev);
+
+/* Write the header of a binary event file to out. */
+void EventBinaryHeader(unsigned char out[EVENT_HEADER_SIZE]);
+
+/*
+ * Encode ev to a record of a binary event file.
+ * Returns 0 on success, -1 if ev is a comment, which has no record.
+*/
+int EventBinaryRecord(const struct event* ev, unsigned char out[EVENT_RECORD_SIZE]);
+
+/* Unmap the event file, if EventParserOpen mapped one. */
+void EventParserClose(struct event_parser* P);
+
+#endif /* EVENT_PARSER_H */
@@ -0,0 +1,86 @@
+/*
+ * Function definitions for the event ring declared in event_ring.h.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "event_ring.h"
+
+/* Failed checks of the other side's index before yielding the processor */
+#define RING_SPINS 256
+
+int EventRingInit(struct event_ring* R, unsigned long capacity) {
+    unsigned long cap = 64;
+
+    while (cap < capacity) cap <<= 1;
+
+    R->slots = (struct event*) malloc(cap * sizeof(struct event));
+    if (R->slots == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return -1;
+    }
+    R->capacity = cap;
+    R->head = R->cached_tail = 0;
+    R->tail = R->cached_head = 0;
+    R->closed = 0;
+
+    return 0;
+}
+
+void EventRingDestroy(struct event_ring* R) {
+    free(R->slots);
+    R->slots = NULL;
+    R->capacity = 0;
+}
+
+/* Let the other side run, after spins failed checks */
+static void Backoff(unsigned* spins) {
+    if (++(*spins) >= RING_SPINS) {
+        sched_yield();
+        *spins = 0;
+    }
+}
+
+void EventRingPush(struct event_ring* R, const struct event* ev) {
+    unsigned long head = R->head;   /* Only this thread writes head */
+    unsigned spins = 0;
+
+    /* Full: wait for the consumer to free a slot */
+    while (head - R->cached_tail == R->capacity) {
+        R->cached_tail = __atomic_load_n(&R->tail, __ATOMIC_ACQUIRE);
+        if (head - R->cached_tail == R->capacity) Backoff(&spins);
+    }
+
+    R->slots[head & (R->capacity - 1)] = *ev;
+    __atomic_store_n(&R->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void EventRingClose(struct event_ring* R) {
+    __atomic_store_n(&R->closed, 1, __ATOMIC_RELEASE);
+}
+
+int EventRingPop(struct event_ring* R, struct event* ev) {
+    unsigned long tail = R->tail;   /* Only this thread writes tail */
+    unsigned spins = 0;
+
+    /* Empty: wait for the producer, unless it is done */
+    while (tail == R->cached_head) {
+        R->cached_head = __atomic_load_n(&R->head, __ATOMIC_ACQUIRE);
+        if (tail != R->cached_head) break;
+
+        if (__atomic_load_n(&R->closed, __ATOMIC_ACQUIRE)) {
+            /* Events pushed before closing are visible now */
+            R->cached_head = __atomic_load_n(&R->head, __ATOMIC_ACQUIRE);
+            if (tail == R->cached_head) return 0;
+            break;
+        }
+        Backoff(&spins);
+    }
+
+    *ev = R->slots[tail & (R->capacity - 1)];
+    __atomic_store_n(&R->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
@@ -0,0 +1,58 @@
+/*
+ * Lock-free ring of events from one producer thread to one consumer
+ * thread, used by the pipelined input mode of main.c: the parser thread
+ * pushes the events of the event file and the executor thread pops and
+ * executes them, in the same order.
+ *
+ * The producer only writes head and the consumer only writes tail. Each
+ * side publishes its index with a release store and reads the other
+ * one with an acquire load, so a slot is never read before it is
+ * written. A side spins for a while when the ring is full (or empty),
+ * then yields the processor.
+*/
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include "event_parser.h"
+
+/* Assumed cache line size, the indices of the two sides are kept apart */
+#define RING_CACHE_LINE 64
+
+struct event_ring {
+    struct event* slots;
+    unsigned long capacity;             /* Always a power of two */
+
+    char pad0[RING_CACHE_LINE];
+    unsigned long head;                 /* Events pushed so far, written by the producer */
+    unsigned long cached_tail;          /* Producer's copy of tail */
+    int closed;                         /* Set by the producer after its last push */
+
+    char pad1[RING_CACHE_LINE];
+    unsigned long tail;                 /* Events popped so far, written by the consumer */
+    unsigned long cached_head;          /* Consumer's copy of head */
+
+    char pad2[RING_CACHE_LINE];
+};
+
+/*
+ * Allocate a ring with room for at least capacity events.
+ * Returns 0 on success, -1 otherwise.
+*/
+int EventRingInit(struct event_ring* R, unsigned long capacity);
+
+/* Deallocate the slots of the ring. */
+void EventRingDestroy(struct event_ring* R);
+
+/* Producer: add a copy of ev to the ring, waiting while it is full. */
+void EventRingPush(struct event_ring* R, const struct event* ev);
+
+/* Producer: no more events will be pushed. */
+void EventRingClose(struct event_ring* R);
+
+/*
+ * Consumer: take the oldest event of the ring to ev, waiting while it is empty.
+ * Returns 1 if an event was taken, 0 if the ring is empty and closed.
+*/
+int EventRingPop(struct event_ring* R, struct event* ev);
+
+#endif /* EVENT_RING_H */
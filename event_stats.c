@@ -0,0 +1,109 @@
+/*
+ * Function definitions for the event statistics declared in event_stats.h.
+*/
+#ifdef EVENT_STATS
+
+#define _POSIX_C_SOURCE 199309L
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "event_stats.h"
+
+/* Each power of two range is cut into 1 << SUB_BITS buckets */
+#define SUB_BITS 2
+#define SUB (1UL << SUB_BITS)
+
+/* Enough buckets for any unsigned long */
+#define NBUCKETS ((CHAR_BIT * sizeof(unsigned long) - SUB_BITS + 1) * SUB)
+
+struct event_stat {
+    unsigned long count;
+    unsigned long samples;  /* Timings recorded, one for each batch */
+    unsigned long misses;
+    unsigned long total_ns;
+    unsigned long max_ns;
+    unsigned long hist[NBUCKETS];
+};
+
+/* Indexed by the event letter */
+static struct event_stat stats[UCHAR_MAX + 1];
+
+unsigned long EventStatsNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + (unsigned long)ts.tv_nsec;
+}
+
+/* Histogram bucket of ns: exact below 2 * SUB, then SUB buckets per power of two */
+static unsigned Bucket(unsigned long ns) {
+    unsigned e = 0;
+
+    if (ns < 2 * SUB) return (unsigned)ns;
+
+    while ((ns >> e) > 1) e++;
+    return (unsigned)((e - SUB_BITS + 1) * SUB + ((ns >> (e - SUB_BITS)) & (SUB - 1)));
+}
+
+/* Largest number of nanoseconds that falls in bucket b */
+static unsigned long BucketHigh(unsigned b) {
+    unsigned e;
+
+    if (b < 2 * SUB) return b;
+
+    e = (unsigned)(b / SUB) + SUB_BITS - 1;
+    return ((SUB + b % SUB) << (e - SUB_BITS)) + (1UL << (e - SUB_BITS)) - 1;
+}
+
+void EventStatsRecord(char type, unsigned long ns, unsigned n, unsigned misses) {
+    struct event_stat* S = &stats[(unsigned char)type];
+
+    if (n == 0) return;
+
+    S->count += n;
+    S->samples++;
+    S->misses += misses;
+    S->total_ns += ns;
+    if (ns > S->max_ns) S->max_ns = ns;
+    S->hist[Bucket(ns)]++;
+}
+
+/* Upper bound of the latency below which a fraction q of the samples of S fall */
+static unsigned long Percentile(const struct event_stat* S, double q) {
+    unsigned long rank = (unsigned long)(q * S->samples);
+    unsigned long seen = 0;
+    unsigned b;
+
+    if (rank < 1) rank = 1;
+    for (b = 0; b < NBUCKETS; ++b) {
+        seen += S->hist[b];
+        if (seen >= rank) break;
+    }
+
+    return (BucketHigh(b) < S->max_ns) ? BucketHigh(b) : S->max_ns;
+}
+
+void EventStatsReport(FILE* out) {
+    const struct event_stat* S;
+    unsigned t;
+
+    fprintf(out, "Event latency (ns)\n");
+    fprintf(out, "%5s %10s %10s %10s %10s %10s %10s %10s %10s\n",
+            "event", "count", "misses", "mean", "p50", "p99", "p999", "max", "samples");
+
+    for (t = 0; t <= UCHAR_MAX; ++t) {
+        S = &stats[t];
+        if (S->count == 0) continue;
+
+        fprintf(out, "%5c %10lu %10lu %10lu %10lu %10lu %10lu %10lu %10lu\n", (int)t,
+                S->count, S->misses, S->total_ns / S->count, Percentile(S, 0.5),
+                Percentile(S, 0.99), Percentile(S, 0.999), S->max_ns, S->samples);
+    }
+}
+
+#else
+
+/* ISO C does not allow an empty translation unit */
+typedef int event_stats_disabled;
+
+#endif /* EVENT_STATS */
@@ -0,0 +1,54 @@
+/*
+ * Latency histograms and hit/miss counters of the events.
+ *
+ * Compiled in only with -DEVENT_STATS, for example
+ *     make clean && make CFLAGS="-ansi -g -O2 -DEVENT_STATS"
+ * Otherwise the EVENT_STATS_* macros expand to nothing and no timer
+ * is read.
+ *
+ * main.c times every event it executes with the monotonic clock. An
+ * event is a miss when its event function returns -1: user not found,
+ * movie already inside, and so on. The latencies of each event type go
+ * to a log-linear histogram: every power of two range of nanoseconds
+ * is cut into 4 buckets, so a percentile read off it is at most 25%
+ * above the real one. The report printed at exit gives count, misses,
+ * mean, p50, p99, p999 and max of every event type seen.
+ *
+ * Consecutive T events are executed as one batch, which is timed as a
+ * whole. The batch is one sample of the histogram, so p50 to max of T
+ * are latencies of batches, not of single events; the samples column
+ * of the report gives how many there were.
+*/
+#ifndef EVENT_STATS_H
+#define EVENT_STATS_H
+
+#ifdef EVENT_STATS
+
+#include <stdio.h>
+
+/* Nanoseconds since an arbitrary start, from the monotonic clock */
+unsigned long EventStatsNow(void);
+
+/*
+ * Count n events of type, executed together in ns nanoseconds,
+ * misses of them failed. The n events are one sample of the histogram.
+*/
+void EventStatsRecord(char type, unsigned long ns, unsigned n, unsigned misses);
+
+/* Print the report of every event type recorded to out. */
+void EventStatsReport(FILE* out);
+
+#define EVENT_STATS_NOW() EventStatsNow()
+#define EVENT_STATS_RECORD(type, start, n, misses) \
+    EventStatsRecord((type), EventStatsNow() - (start), (n), (misses))
+#define EVENT_STATS_REPORT() EventStatsReport(stderr)
+
+#else
+
+#define EVENT_STATS_NOW() 0UL
+#define EVENT_STATS_RECORD(type, start, n, misses) ((void)(start), (void)(misses))
+#define EVENT_STATS_REPORT() ((void)0)
+
+#endif /* EVENT_STATS */
+
+#endif /* EVENT_STATS_H */
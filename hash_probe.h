@@ -0,0 +1,65 @@
+/*
+ * Probing rules shared by the open addressing tables of hash_table.c
+ * and mid_set.c: the hash, the load factor and the backward shift
+ * deletion. Internal to those two files, every function is static.
+*/
+#ifndef HASH_PROBE_H
+#define HASH_PROBE_H
+
+#include <string.h>
+
+/* Grow when more than 7/10 of the slots are occupied */
+#define HASH_LOAD_NUM 7
+#define HASH_LOAD_DEN 10
+
+/* Slots of the smallest table */
+#define HASH_MIN_CAPACITY 8
+
+/* Scramble the bits of key, so that consecutive ids spread over the table */
+static unsigned HashScramble(unsigned key) {
+    key ^= key >> 16;
+    key *= 0x85ebca6bU;
+    key ^= key >> 13;
+    key *= 0xc2b2ae35U;
+    key ^= key >> 16;
+    return key;
+}
+
+/*
+ * Returns the capacity (HASH_MIN_CAPACITY if 0), doubled until n keys
+ * fit without going over the load factor.
+*/
+static unsigned HashCapacityFor(unsigned capacity, unsigned n) {
+    if (capacity == 0) capacity = HASH_MIN_CAPACITY;
+    while (n * HASH_LOAD_DEN > capacity * HASH_LOAD_NUM) capacity <<= 1;
+    return capacity;
+}
+
+/*
+ * Remove the entry at slot hole of a table of mask + 1 slots of
+ * slot_size bytes. Every following entry of the probe run whose
+ * preferred slot is not between the hole and its position is moved
+ * back, so the table never contains tombstones. occupied and key read
+ * a slot. Returns the slot left over, which the caller marks empty.
+*/
+static unsigned HashShiftBack(void* slots, size_t slot_size, unsigned mask, unsigned hole,
+                              int (*occupied)(const void*), unsigned (*key)(const void*)) {
+    char* base = (char*) slots;
+    unsigned i = hole;
+    unsigned home;      /* Preferred slot of the entry at i */
+
+    for (;;) {
+        i = (i + 1) & mask;
+        if (!occupied(base + i * slot_size)) break;
+
+        home = HashScramble(key(base + i * slot_size)) & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            memcpy(base + hole * slot_size, base + i * slot_size, slot_size);
+            hole = i;
+        }
+    }
+
+    return hole;
+}
+
+#endif /* HASH_PROBE_H */
@@ -0,0 +1,125 @@
+/*
+ * Function definitions for the open addressing hash table
+ * declared in hash_table.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "hash_table.h"
+#include "hash_probe.h"
+
+int HashTableInit(struct hash_table* T, unsigned capacity) {
+    unsigned cap = HASH_MIN_CAPACITY;
+
+    while (cap < capacity) cap <<= 1;
+
+    T->slots = (struct hash_slot*) calloc(cap, sizeof(struct hash_slot));
+    if (T->slots == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        T->capacity = T->size = T->peak = 0;
+        return -1;
+    }
+    T->capacity = cap;
+    T->size = T->peak = 0;
+
+    return 0;
+}
+
+void HashTableDestroy(struct hash_table* T) {
+    free(T->slots);
+    T->slots = NULL;
+    T->capacity = T->size = T->peak = 0;
+}
+
+/* Returns the slot holding key, or the empty slot that ends its probe run */
+static struct hash_slot* FindSlot(const struct hash_table* T, unsigned key) {
+    unsigned mask = T->capacity - 1;
+    unsigned i = HashScramble(key) & mask;
+
+    while (T->slots[i].value != NULL && T->slots[i].key != key) {
+        i = (i + 1) & mask;
+    }
+
+    return &T->slots[i];
+}
+
+/* Move the entries of T to capacity slots. */
+static int Resize(struct hash_table* T, unsigned capacity) {
+    struct hash_table bigger;
+    unsigned i = 0;
+
+    if (HashTableInit(&bigger, capacity) == -1) return -1;
+
+    for (i = 0; i < T->capacity; ++i) {
+        if (T->slots[i].value != NULL) {
+            (*FindSlot(&bigger, T->slots[i].key)) = T->slots[i];
+        }
+    }
+    bigger.size = T->size;
+    bigger.peak = T->peak;
+
+    free(T->slots);
+    (*T) = bigger;
+
+    return 0;
+}
+
+void* HashTableFind(const struct hash_table* T, unsigned key) {
+    return FindSlot(T, key)->value;
+}
+
+int HashTableInsert(struct hash_table* T, unsigned key, void* value) {
+    struct hash_slot* slot;
+
+    if (HashTableReserve(T, 1) == -1) return -1;
+
+    slot = FindSlot(T, key);
+    if (slot->value != NULL) return 1; /* key is already inside */
+
+    slot->key = key;
+    slot->value = value;
+    if (++T->size > T->peak) T->peak = T->size;
+
+    return 0;
+}
+
+int HashTableReserve(struct hash_table* T, unsigned n) {
+    unsigned capacity = HashCapacityFor(T->capacity, T->size + n);
+
+    if (capacity == T->capacity) return 0;
+
+    return Resize(T, capacity);
+}
+
+int HashTableReplace(struct hash_table* T, unsigned key, void* value) {
+    struct hash_slot* slot = FindSlot(T, key);
+
+    if (slot->value == NULL) return -1; /* key not found */
+
+    slot->value = value;
+
+    return 0;
+}
+
+/* Read a slot for HashShiftBack() */
+static int SlotOccupied(const void* slot) {
+    return ((const struct hash_slot*) slot)->value != NULL;
+}
+
+static unsigned SlotKey(const void* slot) {
+    return ((const struct hash_slot*) slot)->key;
+}
+
+void* HashTableRemove(struct hash_table* T, unsigned key) {
+    struct hash_slot* slot = FindSlot(T, key);
+    void* value = slot->value;
+    unsigned hole;
+
+    if (value == NULL) return NULL; /* key not found */
+
+    hole = HashShiftBack(T->slots, sizeof(struct hash_slot), T->capacity - 1,
+                         (unsigned)(slot - T->slots), SlotOccupied, SlotKey);
+    T->slots[hole].value = NULL;
+    T->size--;
+
+    return value;
+}
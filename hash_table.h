@@ -0,0 +1,58 @@
+/*
+ * Open addressing hash table (linear probing) that maps unsigned keys
+ * to non-NULL pointers. It is used as an index next to the lists of
+ * streaming_service.c, so that lookups by id do not scan the lists.
+ *
+ * Deletion shifts the following entries of the probe run backwards,
+ * so the table never contains tombstones.
+*/
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
+struct hash_slot {
+    unsigned key;
+    void* value;        /* NULL marks an empty slot */
+};
+
+struct hash_table {
+    struct hash_slot* slots;
+    unsigned capacity;  /* Always a power of two */
+    unsigned size;      /* Number of occupied slots */
+    unsigned peak;      /* Max value of size so far */
+};
+
+/*
+ * Allocate a table with room for at least capacity slots.
+ * Returns 0 on success, -1 otherwise.
+*/
+int HashTableInit(struct hash_table* T, unsigned capacity);
+
+/* Deallocate the slots of the table. Values are not touched. */
+void HashTableDestroy(struct hash_table* T);
+
+/* Returns the value stored with key, NULL if key is not in the table. */
+void* HashTableFind(const struct hash_table* T, unsigned key);
+
+/*
+ * Store value (must not be NULL) under key.
+ * Returns 0 on success, 1 if key is already inside (the table is not
+ * modified) and -1 on malloc error.
+*/
+int HashTableInsert(struct hash_table* T, unsigned key, void* value);
+
+/*
+ * Make room for n more keys, so that the next n insertions
+ * can not fail. Returns 0 on success, -1 on malloc error.
+*/
+int HashTableReserve(struct hash_table* T, unsigned n);
+
+/*
+ * Store value (must not be NULL) under key, which must already be inside.
+ * Returns 0 on success, -1 if key is not in the table.
+*/
+int HashTableReplace(struct hash_table* T, unsigned key, void* value);
+
+/* Remove key from the table. Returns its value, NULL if it was not inside. */
+void* HashTableRemove(struct hash_table* T, unsigned key);
+
+#endif /* HASH_TABLE_H */
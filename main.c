@@ -12,17 +12,21 @@
  * @see   Compile using supplied Makefile by running: make
  * ============================================
  */
-#include <ctype.h>
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "streaming_service.h"
+#include "year_filter.h"
+#include "event_parser.h"
+#include "event_ring.h"
+#include "event_stats.h"
+#include "output.h"
 
 #include "cleaning_functions.h" /* Functions for memory deallocation*/
 
-/* Maximum input line size */
-#define MAX_LINE 1024
-
 /* 
  * Uncomment the following line to
  * enable debugging prints
@@ -38,37 +42,93 @@
 
 /* Global Variables */
 
-struct movie* category_array[6]; 	/* Each element is the head of an SLL */
+struct category_list category_array[6]; 	/* Sorted movies of each category */
 struct new_movie* new_movies_list;	/* Head of new movies SLL */
+struct new_movie* staged_movies;	/* New movies not yet merged into new_movies_list */
 struct user* user_list;				/* Head of user list SLL */
 struct user* guard;		            /* Guard used in user list */ 
+struct hash_table user_index;		/* uid -> node of user_list */
+struct hash_table movie_index;		/* mid -> struct catalog_entry */
+struct hash_table new_movie_index;	/* mid -> struct new_movie, staged or not */
+struct hash_table suggestion_index;	/* mid -> chain of struct suggested_movie */
+
+/* Node allocators */
+struct pool movie_pool;
+struct pool suggested_pool;
+struct pool new_movie_pool;
+struct pool user_pool;
+
+/* Allocate the index T, or exit, as the service can not run without it */
+static void init_index(struct hash_table *T, const char *name)
+{
+	if (HashTableInit(T, 64) == -1) {
+		fprintf(stderr, "Could not allocate the %s index\n", name);
+		exit(EXIT_FAILURE);
+	}
+}
 
 /* Initialization of global variables */
 void init_structures(void)
 {
-	/* Initialization of category table*/
     int i = 0;
+
+	/* Initialization of the node allocators */
+	PoolInit(&movie_pool, "movie", sizeof(struct movie));
+	PoolInit(&suggested_pool, "sugg_segment", sizeof(struct sugg_segment));
+	PoolInit(&new_movie_pool, "new_movie", sizeof(struct new_movie));
+	PoolInit(&user_pool, "user", sizeof(struct user));
+
+	/* Initialization of category table*/
     for (i = 0; i < 6; ++i) {
-        category_array[i] = NULL;
+        category_array[i].mids = NULL;
+        category_array[i].years = NULL;
+        category_array[i].size = 0;
+        category_array[i].capacity = 0;
+        category_array[i].buckets = NULL;
+        category_array[i].nbuckets = 0;
+        category_array[i].bucket_capacity = 0;
     }
+
+	/* Initialization of the index used to find movies by mid */
+	init_index(&movie_index, "movie");
     
 	/* Initialization of the list containing the new movies */
     new_movies_list = NULL;
+    staged_movies = NULL;
+	init_index(&new_movie_index, "new movie");
     
     /* Initialization of Guard Node */ 
-    guard = (struct user*) malloc(sizeof(struct user));
+    guard = (struct user*) PoolAlloc(&user_pool);
     if (guard == NULL) {
         fprintf(stderr, "Malloc error\n");
-        return ;
+        exit(EXIT_FAILURE);
     }
     guard->uid = -1;
+	guard->order = 0;
 	guard->suggestedHead = NULL;
 	guard->suggestedTail = NULL;
+	MidSetInit(&guard->suggestedSet);
     guard->watchHistory = NULL;
+	guard->prev = NULL;
 	guard->next = NULL;
 
 	/* Initialization of list containing the users*/
     user_list = guard;
+
+	/* Initialization of the index used to find users by uid */
+	init_index(&user_index, "user");
+
+	/* Initialization of the index from mid to the suggested lists holding it */
+	init_index(&suggestion_index, "suggestion");
+}
+
+/* Set by --memory-report, to print the memory report at exit */
+static int memory_report = 0;
+
+/* Print a line of the memory report to stderr */
+static void put_stderr(const char *line)
+{
+	fputs(line, stderr);
 }
 
 /* Memory deallocation */
@@ -78,6 +138,11 @@ void destroy_structures(void)
 	struct user* user_next = NULL;
 	int i = 0;
 
+	if (memory_report) {
+		fputs("Memory at exit:\n", stderr);
+		MemoryReport(put_stderr);
+	}
+
 	/* Deallocate lists related to users */
 	while (user_tmp != guard) {
 		/* Deallocate Watch history stack and suggested movies list*/
@@ -86,138 +151,323 @@ void destroy_structures(void)
 		
 		/* Deallocate the user node*/
 		user_next = user_tmp->next;
-		free(user_tmp);
+		PoolFree(&user_pool, user_tmp);
 		user_tmp = user_next;
 	}
 	
 	/* Deallocate guard node*/
-	free(guard);
+	PoolFree(&user_pool, guard);
 	guard = NULL;
+	HashTableDestroy(&user_index);
+	HashTableDestroy(&suggestion_index);
 
 	/* Deallocate category lists*/
 	for (i = 0; i < 6; ++i) {
 		CleanCategoryList(&category_array[i]);
 	}
+	HashTableDestroy(&movie_index);
 
 	/* Deallocate new movie list*/
 	CleanNewMoviesList(&new_movies_list);
+	CleanNewMoviesList(&staged_movies);
+	HashTableDestroy(&new_movie_index);
+
+#ifdef DEBUG
+	/* Every count but the pool slabs should be back to zero */
+	fputs("Memory after deallocation:\n", stderr);
+	MemoryReport(put_stderr);
+	PoolPrintStats(&movie_pool, stderr);
+	PoolPrintStats(&suggested_pool, stderr);
+	PoolPrintStats(&new_movie_pool, stderr);
+	PoolPrintStats(&user_pool, stderr);
+#endif /* DEBUG */
+
+	/* Deallocate the slabs of the node allocators */
+	PoolDestroy(&movie_pool);
+	PoolDestroy(&suggested_pool);
+	PoolDestroy(&new_movie_pool);
+	PoolDestroy(&user_pool);
+}
+
+/* Print the command line options and exit */
+void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [options] <input_file>\n"
+			"Options:\n"
+			"  --filter=KERNEL  year filter of event F: scalar, sse2, avx2 or auto\n"
+			"  --input=MODE     read the event file with mmap (default), stdio,\n"
+			"                   or pipeline: mmap, parsed on a thread of its own\n"
+			"                   (binary event files need mmap or pipeline)\n"
+			"  --output=MODE    what the events print: full (default), delta or status\n"
+			"  --writer=MODE    write the output directly (default) or from a\n"
+			"                   thread of its own: direct or thread\n"
+			"  --memory-report  print the memory taken by every structure\n"
+			"                   to stderr at exit, as event I does\n"
+			"  --dedupe         events S, F and Q do not add a movie to a\n"
+			"                   suggested list that already holds it\n",
+			prog);
+	exit(EXIT_FAILURE);
+}
+
+/* Mids of the consecutive T events not yet executed */
+#define TAKE_OFF_BATCH 256
+static unsigned take_off_mids[TAKE_OFF_BATCH];
+static unsigned take_off_count = 0;
+
+/* Execute the T events collected by execute_event, as one batch */
+void flush_take_offs(void)
+{
+	unsigned long start = EVENT_STATS_NOW();
+	unsigned found;
+
+	if (take_off_count == 0)
+		return;
+
+	found = take_off_movies(take_off_mids, take_off_count);
+	EVENT_STATS_RECORD('T', start, take_off_count, take_off_count - found);
+	take_off_count = 0;
+}
+
+/*
+ * Execute an event parsed from the event file.
+ * Consecutive T events are collected and executed together by the
+ * first other event, or by flush_take_offs at the end of the file.
+ * With -DEVENT_STATS every event is timed, see event_stats.h.
+ */
+void execute_event(const struct event *ev)
+{
+	unsigned long start;
+	int result = 0;
+
+	if (ev->type == 'T' && ev->status == EVENT_OK) {
+		if (take_off_count == TAKE_OFF_BATCH)
+			flush_take_offs();
+		take_off_mids[take_off_count++] = ev->mid;
+		return;
+	}
+	flush_take_offs();
+	start = EVENT_STATS_NOW();
+
+	if (ev->status == EVENT_PARSE_ERROR) {
+		fprintf(stderr, "Event %c parsing error\n", ev->type);
+		return;
+	}
+
+	switch (ev->type) {
+		/* Comment, ignore this line */
+		case '#':
+			break;
+		case 'R':
+			result = register_user(ev->uid);
+			break;
+		case 'U':
+			result = unregister_user(ev->uid);
+			break;
+		case 'A':
+			result = add_new_movie(ev->mid, (movieCategory_t)ev->category1, ev->year);
+			break;
+		case 'D':
+			distribute_new_movies();
+			break;
+		case 'W':
+			result = watch_movie(ev->uid, ev->mid);
+			break;
+		case 'S':
+			result = suggest_movies(ev->uid);
+			break;
+		case 'F':
+			result = filtered_movie_search(ev->uid,
+					(movieCategory_t)ev->category1,
+					(movieCategory_t)ev->category2, ev->year);
+			break;
+		case 'Q':
+			result = filtered_multi_search(ev->uid, ev->mask,
+					ev->year);
+			break;
+		case 'M':
+			print_movies();
+			break;
+		case 'P':
+			print_users();
+			break;
+		case 'I':
+			print_memory();
+			break;
+		default:
+			fprintf(stderr, "WARNING: Unrecognized event %c. Continuing...\n",
+					ev->type);
+			break;
+	}
+	EVENT_STATS_RECORD(ev->type, start, 1, result == -1);
+}
+
+/* A line without an event type ends the program */
+void bad_line(const struct event *ev)
+{
+	flush_take_offs();
+	EVENT_STATS_REPORT();
+	fprintf(stderr, "Could not parse event type out of input line:\n\t%.*s",
+			(int)ev->line_len, ev->line);
+	OutputFlush();
+	exit(EXIT_FAILURE);
+}
+
+/* Number of parsed events the parser thread may run ahead */
+#define PIPELINE_EVENTS 4096
+
+/* Event file parsed on a thread, the events are passed through ring */
+struct pipeline {
+	struct event_parser parser;
+	struct event_ring ring;
+};
+
+/* Parser thread of the pipelined input */
+static void *parser_thread(void *arg)
+{
+	struct pipeline *pl = (struct pipeline *)arg;
+	struct event ev;
+
+	while (EventParserNext(&pl->parser, &ev)) {
+		EventRingPush(&pl->ring, &ev);
+		/* The executor stops at a line without an event type */
+		if (ev.status == EVENT_NO_TYPE)
+			break;
+	}
+	EventRingClose(&pl->ring);
+
+	return NULL;
+}
+
+/*
+ * Execute the events of the mapped event file, parsed on another
+ * thread while this one executes the events parsed before them.
+ * Returns 0 on success, -1 if the thread could not be started.
+ */
+int run_pipeline(struct pipeline *pl)
+{
+	pthread_t parser;
+	struct event ev;
+
+	if (EventRingInit(&pl->ring, PIPELINE_EVENTS) == -1)
+		return -1;
+	if (pthread_create(&parser, NULL, parser_thread, pl) != 0) {
+		fprintf(stderr, "Could not start the parser thread\n");
+		EventRingDestroy(&pl->ring);
+		return -1;
+	}
+
+	while (EventRingPop(&pl->ring, &ev)) {
+		if (ev.status == EVENT_NO_TYPE)
+			bad_line(&ev);
+		execute_event(&ev);
+	}
+
+	pthread_join(parser, NULL);
+	EventRingDestroy(&pl->ring);
+	return 0;
 }
 
 int main(int argc, char *argv[])
 {
 	FILE *event_file;
+	struct pipeline pl;
+	struct event ev;
 	char line_buffer[MAX_LINE];
+	int use_stdio = 0;
+	int use_pipeline = 0;
+	int use_writer = 0;
+	int i;
 
-	if (argc != 2) {
-		fprintf(stderr, "Usage: %s <input_file>\n",
-				argv[0]);
-		exit(EXIT_FAILURE);
-	}
+	if (argc < 2)
+		usage(argv[0]);
 
-	event_file = fopen(argv[1], "r");
-	if (!event_file) {
-		perror("fopen error for event file open");
-		exit(EXIT_FAILURE);
+	/* Options come first, the last argument is the event file */
+	for (i = 1; i < argc - 1; ++i) {
+		if (strncmp(argv[i], "--filter=", 9) == 0) {
+			if (YearFilterSelect(argv[i] + 9) == -1) {
+				fprintf(stderr, "Year filter %s is not supported\n",
+						argv[i] + 9);
+				exit(EXIT_FAILURE);
+			}
+		} else if (strncmp(argv[i], "--output=", 9) == 0) {
+			if (OutputSelect(argv[i] + 9) == -1) {
+				fprintf(stderr, "Output mode %s is not supported\n",
+						argv[i] + 9);
+				exit(EXIT_FAILURE);
+			}
+		} else if (strcmp(argv[i], "--input=mmap") == 0) {
+			use_stdio = use_pipeline = 0;
+		} else if (strcmp(argv[i], "--input=stdio") == 0) {
+			use_stdio = 1;
+			use_pipeline = 0;
+		} else if (strcmp(argv[i], "--input=pipeline") == 0) {
+			use_stdio = 0;
+			use_pipeline = 1;
+		} else if (strcmp(argv[i], "--memory-report") == 0) {
+			memory_report = 1;
+		} else if (strcmp(argv[i], "--dedupe") == 0) {
+			dedupe_suggestions = 1;
+		} else if (strcmp(argv[i], "--writer=direct") == 0) {
+			use_writer = 0;
+		} else if (strcmp(argv[i], "--writer=thread") == 0) {
+			use_writer = 1;
+		} else {
+			usage(argv[0]);
+		}
 	}
 
-	init_structures();
-	while (fgets(line_buffer, MAX_LINE, event_file)) {
-		char *trimmed_line;
-		char event;
-		int uid;
-		unsigned mid, year;
-		movieCategory_t category1, category2;
+	/* Without the thread the output is still written, directly */
+	if (use_writer && OutputStartWriter() == -1)
+		fprintf(stderr, "Could not start the writer thread\n");
+
+	if (use_stdio) {
+		event_file = fopen(argv[argc - 1], "r");
+		if (!event_file) {
+			perror("fopen error for event file open");
+			exit(EXIT_FAILURE);
+		}
+
+		init_structures();
+		while (fgets(line_buffer, MAX_LINE, event_file)) {
+			EventParseLine(line_buffer, &ev);
+			if (ev.status == EVENT_NO_TYPE) {
+				fclose(event_file);
+				bad_line(&ev);
+			}
+			execute_event(&ev);
+		}
+		fclose(event_file);
+	} else {
 		/*
-		 * First trim any whitespace
-		 * leading the line.
-		 */
-		trimmed_line = line_buffer;
-		while (trimmed_line && isspace(*trimmed_line))
-			trimmed_line++;
-		if (!trimmed_line)
-			continue;
-		/* 
-		 * Find the event,
-		 * or comment starting with #
+		 * The event file is scanned in place, or decoded if it is
+		 * a binary event file, see event_parser.h
 		 */
-		if (sscanf(trimmed_line, "%c", &event) != 1) {
-			fprintf(stderr, "Could not parse event type out of input line:\n\t%s",
-					trimmed_line);
-			fclose(event_file);
+		i = EventParserOpen(&pl.parser, argv[argc - 1]);
+		if (i == -1)
+			perror("fopen error for event file open");
+		if (i != 0)
 			exit(EXIT_FAILURE);
-		}
 
-		switch (event) {
-			/* Comment, ignore this line */
-			case '#':
-				break;
-			case 'R':
-				if (sscanf(trimmed_line, "R %d", &uid) != 1) {
-					fprintf(stderr, "Event R parsing error\n");
-					break;
-				}
-				register_user(uid);
-				break;
-			case 'U':
-				if (sscanf(trimmed_line, "U %d", &uid) != 1) {
-					fprintf(stderr, "Event U parsing error\n");
-					break;
-				}
-				unregister_user(uid);
-				break;
-			case 'A':
-				if (sscanf(trimmed_line, "A %u %d %u", &mid, &category1,
-							&year) != 3) {
-					fprintf(stderr, "Event A parsing error\n");
-					break;
-				}
-				add_new_movie(mid, category1, year);
-				break;
-			case 'D':
-				distribute_new_movies();
-				break;
-			case 'W':
-				if (sscanf(trimmed_line, "W %d %u", &uid, &mid) != 2) {
-					fprintf(stderr, "Event W parsing error\n");
-					break;
-				}
-				watch_movie(uid, mid);
-				break;
-			case 'S':
-				if (sscanf(trimmed_line, "S %d", &uid) != 1) {
-					fprintf(stderr, "Event S parsing error\n");
-					break;
-				}
-				suggest_movies(uid);
-				break;
-			case 'F':
-				if (sscanf(trimmed_line, "F %d %d %d %u", &uid, &category1,
-							&category2, &year) != 4) {
-					fprintf(stderr, "Event F parsing error\n");
-					break;
-				}
-				filtered_movie_search(uid, category1, category2, year);
-				break;
-			case 'T':
-				if (sscanf(trimmed_line, "T %u", &mid) != 1) {
-					fprintf(stderr, "Event T parsing error\n");
-					break;
-				}
-				take_off_movie(mid);
-				break;
-			case 'M':
-				print_movies();
-				break;
-			case 'P':
-				print_users();
-				break;
-			default:
-				fprintf(stderr, "WARNING: Unrecognized event %c. Continuing...\n",
-						event);
-				break;
+		init_structures();
+		if (use_pipeline) {
+			if (run_pipeline(&pl) == -1) {
+				EventParserClose(&pl.parser);
+				destroy_structures();
+				exit(EXIT_FAILURE);
+			}
+		} else {
+			while (EventParserNext(&pl.parser, &ev)) {
+				if (ev.status == EVENT_NO_TYPE)
+					bad_line(&ev);
+				execute_event(&ev);
+			}
 		}
+		EventParserClose(&pl.parser);
 	}
-	fclose(event_file);
+
+	flush_take_offs();
+	EVENT_STATS_REPORT();
 	destroy_structures();
+	OutputClose();
 	return 0;
 }
@@ -0,0 +1,23 @@
+/*
+ * Function definitions for the memory accounting declared in mem_account.h.
+*/
+#include <stdio.h>
+#include "mem_account.h"
+
+void MemAccountAdd(struct mem_account* A, unsigned long nodes, size_t bytes) {
+    A->nodes += nodes;
+    A->bytes += (unsigned long)bytes;
+
+    if (A->nodes > A->peak_nodes) A->peak_nodes = A->nodes;
+    if (A->bytes > A->peak_bytes) A->peak_bytes = A->bytes;
+}
+
+void MemAccountSub(struct mem_account* A, unsigned long nodes, size_t bytes) {
+    A->nodes -= nodes;
+    A->bytes -= (unsigned long)bytes;
+}
+
+void MemAccountFormat(const struct mem_account* A, const char* name, char* line) {
+    sprintf(line, "  %-17.17s %10lu %10lu %12lu %12lu\n",
+            name, A->nodes, A->peak_nodes, A->bytes, A->peak_bytes);
+}
@@ -0,0 +1,36 @@
+/*
+ * Memory accounting of a data structure that is not kept in a pool:
+ * the number of nodes (elements) it holds and the bytes allocated for
+ * it, with the largest values seen so far. The allocation sites report
+ * every change, so the numbers are exact.
+ *
+ * Structures kept in a pool are accounted by the pool itself, see pool.h.
+*/
+#ifndef MEM_ACCOUNT_H
+#define MEM_ACCOUNT_H
+
+#include <stddef.h>
+
+struct mem_account {
+    unsigned long nodes;
+    unsigned long peak_nodes;
+    unsigned long bytes;
+    unsigned long peak_bytes;
+};
+
+/* Room for any line written by MemAccountFormat */
+#define MEM_ACCOUNT_LINE 128
+
+/* Count nodes more nodes, taking bytes more bytes. */
+void MemAccountAdd(struct mem_account* A, unsigned long nodes, size_t bytes);
+
+/* Count nodes fewer nodes, taking bytes fewer bytes. */
+void MemAccountSub(struct mem_account* A, unsigned long nodes, size_t bytes);
+
+/*
+ * Write the line of the memory report for A, with the label name, to line
+ * (MEM_ACCOUNT_LINE bytes): name, nodes, peak nodes, bytes, peak bytes.
+*/
+void MemAccountFormat(const struct mem_account* A, const char* name, char* line);
+
+#endif /* MEM_ACCOUNT_H */
@@ -0,0 +1,117 @@
+/*
+ * Function definitions for the counting set of mids declared in mid_set.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "mid_set.h"
+#include "hash_probe.h"
+
+struct mem_account mid_set_memory;
+
+void MidSetInit(struct mid_set* S) {
+    S->slots = NULL;
+    S->capacity = S->size = 0;
+}
+
+void MidSetDestroy(struct mid_set* S) {
+    MemAccountSub(&mid_set_memory, S->size, S->capacity * sizeof(struct mid_slot));
+    free(S->slots);
+    MidSetInit(S);
+}
+
+/* Returns the slot holding mid, or the empty slot that ends its probe run */
+static struct mid_slot* FindSlot(const struct mid_set* S, unsigned mid) {
+    unsigned mask = S->capacity - 1;
+    unsigned i = HashScramble(mid) & mask;
+
+    while (S->slots[i].count != 0 && S->slots[i].mid != mid) {
+        i = (i + 1) & mask;
+    }
+
+    return &S->slots[i];
+}
+
+/* Move the mids of S to capacity slots. */
+static int Resize(struct mid_set* S, unsigned capacity) {
+    struct mid_set bigger;
+    unsigned i;
+
+    bigger.slots = (struct mid_slot*) calloc(capacity, sizeof(struct mid_slot));
+    if (bigger.slots == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return -1;
+    }
+    bigger.capacity = capacity;
+    bigger.size = S->size;
+
+    for (i = 0; i < S->capacity; ++i) {
+        if (S->slots[i].count != 0) (*FindSlot(&bigger, S->slots[i].mid)) = S->slots[i];
+    }
+
+    MemAccountAdd(&mid_set_memory, 0, (capacity - S->capacity) * sizeof(struct mid_slot));
+    free(S->slots);
+    (*S) = bigger;
+
+    return 0;
+}
+
+unsigned MidSetCount(const struct mid_set* S, unsigned mid) {
+    if (S->size == 0) return 0;
+    return FindSlot(S, mid)->count;
+}
+
+int MidSetReserve(struct mid_set* S, unsigned n) {
+    unsigned capacity = HashCapacityFor(S->capacity, S->size + n);
+
+    if (capacity == S->capacity) return 0;
+
+    return Resize(S, capacity);
+}
+
+int MidSetAdd(struct mid_set* S, unsigned mid) {
+    struct mid_slot* slot;
+
+    if (MidSetReserve(S, 1) == -1) return -1;
+
+    slot = FindSlot(S, mid);
+    if (slot->count == 0) {
+        slot->mid = mid;
+        S->size++;
+        MemAccountAdd(&mid_set_memory, 1, 0);
+    }
+    slot->count++;
+
+    return 0;
+}
+
+/* Read a slot for HashShiftBack() */
+static int SlotOccupied(const void* slot) {
+    return ((const struct mid_slot*) slot)->count != 0;
+}
+
+static unsigned SlotKey(const void* slot) {
+    return ((const struct mid_slot*) slot)->mid;
+}
+
+void MidSetRemove(struct mid_set* S, unsigned mid) {
+    struct mid_slot* slot;
+    unsigned hole;
+
+    if (S->size == 0) return;
+
+    slot = FindSlot(S, mid);
+    if (slot->count == 0) return;           /* mid not found */
+    if (--slot->count != 0) return;         /* mid is still inside */
+
+    /* The last one frees the slots */
+    if (S->size == 1) {
+        MidSetDestroy(S);
+        return;
+    }
+
+    hole = HashShiftBack(S->slots, sizeof(struct mid_slot), S->capacity - 1,
+                         (unsigned)(slot - S->slots), SlotOccupied, SlotKey);
+    S->slots[hole].count = 0;
+    S->size--;
+    MemAccountSub(&mid_set_memory, 1, 0);
+}
@@ -0,0 +1,50 @@
+/*
+ * Counting set of mids, kept for every user next to the suggested list
+ * when the events deduplicate (--dedupe), so that "does the list hold
+ * mid, and how many times" is answered without a scan of the list.
+ *
+ * Open addressing (linear probing) over slots of a mid and its count,
+ * 8 bytes each. An empty set holds no memory: the slots are allocated
+ * with the first mid and freed when the last one is removed.
+*/
+#ifndef MID_SET_H
+#define MID_SET_H
+
+#include "mem_account.h"
+
+struct mid_slot {
+    unsigned mid;
+    unsigned count;     /* 0 marks an empty slot */
+};
+
+struct mid_set {
+    struct mid_slot* slots;
+    unsigned capacity;  /* 0 or a power of two */
+    unsigned size;      /* Number of distinct mids */
+};
+
+/* Memory of every set, nodes are distinct mids */
+extern struct mem_account mid_set_memory;
+
+/* Make S an empty set. Nothing is allocated. */
+void MidSetInit(struct mid_set* S);
+
+/* Deallocate the slots of S, which becomes empty. */
+void MidSetDestroy(struct mid_set* S);
+
+/* Returns how many times mid is in S, 0 if it is not. */
+unsigned MidSetCount(const struct mid_set* S, unsigned mid);
+
+/*
+ * Make room for n more mids, so that the next n
+ * additions can not fail. Returns 0 on success, -1 on malloc error.
+*/
+int MidSetReserve(struct mid_set* S, unsigned n);
+
+/* Add mid once more to S. Returns 0 on success, -1 on malloc error. */
+int MidSetAdd(struct mid_set* S, unsigned mid);
+
+/* Remove mid once from S, if it is inside. */
+void MidSetRemove(struct mid_set* S, unsigned mid);
+
+#endif /* MID_SET_H */
@@ -0,0 +1,239 @@
+/*
+ * Function definitions for the buffered output declared in output.h.
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+
+/* Size of an output buffer in bytes */
+#define OUTPUT_BYTES (1 << 20)
+
+/*
+ * Number of output buffers. Without the writer thread only the first
+ * one is used. With it one is filled while the others wait for, or
+ * are in, a write call.
+ */
+#define OUTPUT_BUFFERS 3
+
+/* Room for the digits and sign of any int */
+#define INT_DIGITS 12
+
+enum output_mode output_mode = OUTPUT_FULL;
+
+static char buffers[OUTPUT_BUFFERS][OUTPUT_BYTES];
+static char* buffer = buffers[0];   /* The buffer being filled */
+static size_t used = 0;             /* Bytes of buffer waiting to be written */
+
+/*
+ * Writer thread. The buffers handed to it wait in a queue, in the order
+ * they were filled; the writer takes them from its head and gives them
+ * back to the free list once written. All of it is under lock.
+ */
+static struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t filled;          /* A buffer was queued, or stop was set */
+    pthread_cond_t written;         /* A buffer was written and is free again */
+    char* queue[OUTPUT_BUFFERS];
+    size_t queue_used[OUTPUT_BUFFERS];
+    unsigned head, count;           /* Queued buffers, from queue[head] */
+    char* free_list[OUTPUT_BUFFERS];
+    unsigned nfree;
+    int busy;                       /* Set while the writer is in a write call */
+    int stop;
+    int running;
+} writer;
+
+int OutputSelect(const char* name) {
+    if (strcmp(name, "full") == 0) output_mode = OUTPUT_FULL;
+    else if (strcmp(name, "delta") == 0) output_mode = OUTPUT_DELTA;
+    else if (strcmp(name, "status") == 0) output_mode = OUTPUT_STATUS;
+    else return -1;
+
+    return 0;
+}
+
+/* Write the size bytes of data to the standard output */
+static void WriteAll(const char* data, size_t size) {
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < size) {
+        n = write(STDOUT_FILENO, data + done, size - done);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            perror("write error for standard output");
+            break;
+        }
+        done += (size_t)n;
+    }
+}
+
+static void* WriterThread(void* arg) {
+    char* data;
+    size_t size;
+
+    (void)arg;
+    pthread_mutex_lock(&writer.lock);
+    for (;;) {
+        while (writer.count == 0 && !writer.stop) {
+            pthread_cond_wait(&writer.filled, &writer.lock);
+        }
+        if (writer.count == 0) break;
+
+        data = writer.queue[writer.head];
+        size = writer.queue_used[writer.head];
+        writer.head = (writer.head + 1) % OUTPUT_BUFFERS;
+        writer.count--;
+        writer.busy = 1;
+
+        pthread_mutex_unlock(&writer.lock);
+        WriteAll(data, size);
+        pthread_mutex_lock(&writer.lock);
+
+        writer.busy = 0;
+        writer.free_list[writer.nfree++] = data;
+        pthread_cond_signal(&writer.written);
+    }
+    pthread_mutex_unlock(&writer.lock);
+
+    return NULL;
+}
+
+int OutputStartWriter(void) {
+    unsigned i;
+
+    if (writer.running) return 0;
+
+    writer.head = writer.count = 0;
+    writer.nfree = 0;
+    writer.busy = writer.stop = 0;
+    for (i = 0; i < OUTPUT_BUFFERS; ++i) {
+        if (buffers[i] != buffer) writer.free_list[writer.nfree++] = buffers[i];
+    }
+
+    pthread_mutex_init(&writer.lock, NULL);
+    pthread_cond_init(&writer.filled, NULL);
+    pthread_cond_init(&writer.written, NULL);
+    if (pthread_create(&writer.thread, NULL, WriterThread, NULL) != 0) {
+        pthread_cond_destroy(&writer.written);
+        pthread_cond_destroy(&writer.filled);
+        pthread_mutex_destroy(&writer.lock);
+        return -1;
+    }
+
+    writer.running = 1;
+    return 0;
+}
+
+/*
+ * Hand the filled buffer to the writer thread and continue with a free
+ * one, waiting for the writer if every other buffer is still queued.
+ */
+static void HandOff(void) {
+    pthread_mutex_lock(&writer.lock);
+
+    writer.queue[(writer.head + writer.count) % OUTPUT_BUFFERS] = buffer;
+    writer.queue_used[(writer.head + writer.count) % OUTPUT_BUFFERS] = used;
+    writer.count++;
+    pthread_cond_signal(&writer.filled);
+
+    while (writer.nfree == 0) pthread_cond_wait(&writer.written, &writer.lock);
+    buffer = writer.free_list[--writer.nfree];
+
+    pthread_mutex_unlock(&writer.lock);
+    used = 0;
+}
+
+/* Flush when the buffer being filled is full */
+static void OutputFull(void) {
+    if (writer.running) HandOff();
+    else OutputFlush();
+}
+
+void OutputFlush(void) {
+    if (!writer.running) {
+        WriteAll(buffer, used);
+        used = 0;
+        return;
+    }
+
+    if (used > 0) HandOff();
+
+    /* Wait until everything queued has been written */
+    pthread_mutex_lock(&writer.lock);
+    while (writer.count > 0 || writer.busy) {
+        pthread_cond_wait(&writer.written, &writer.lock);
+    }
+    pthread_mutex_unlock(&writer.lock);
+}
+
+void OutputClose(void) {
+    OutputFlush();
+    if (!writer.running) return;
+
+    pthread_mutex_lock(&writer.lock);
+    writer.stop = 1;
+    pthread_cond_signal(&writer.filled);
+    pthread_mutex_unlock(&writer.lock);
+
+    pthread_join(writer.thread, NULL);
+    pthread_cond_destroy(&writer.written);
+    pthread_cond_destroy(&writer.filled);
+    pthread_mutex_destroy(&writer.lock);
+    writer.running = 0;
+}
+
+void OutputChar(char c) {
+    if (used == OUTPUT_BYTES) OutputFull();
+    buffer[used++] = c;
+}
+
+void OutputString(const char* s) {
+    size_t len = strlen(s);
+    size_t part;
+
+    while (len > 0) {
+        if (used == OUTPUT_BYTES) OutputFull();
+
+        part = OUTPUT_BYTES - used;
+        if (part > len) part = len;
+
+        memcpy(buffer + used, s, part);
+        used += part;
+        s += part;
+        len -= part;
+    }
+}
+
+/* Append the digits of n, negative tells whether to put a minus sign first */
+static void OutputDigits(unsigned n, int negative) {
+    char digits[INT_DIGITS];
+    char* p = digits + INT_DIGITS;
+
+    /* Digits are produced from the last one */
+    do {
+        *--p = (char)('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    if (negative) *--p = '-';
+
+    if (OUTPUT_BYTES - used < INT_DIGITS) OutputFull();
+    memcpy(buffer + used, p, (size_t)(digits + INT_DIGITS - p));
+    used += (size_t)(digits + INT_DIGITS - p);
+}
+
+void OutputInt(int n) {
+    /* Negate in unsigned arithmetic, so that INT_MIN works too */
+    if (n < 0) OutputDigits(0U - (unsigned)n, 1);
+    else OutputDigits((unsigned)n, 0);
+}
+
+void OutputUnsigned(unsigned n) {
+    OutputDigits(n, 0);
+}
@@ -0,0 +1,65 @@
+/*
+ * Buffered standard output of the event functions.
+ *
+ * Output is collected in one large buffer and handed to the system
+ * with a write call whenever the buffer fills and at OutputFlush.
+ * After OutputStartWriter the write calls are made by a writer thread
+ * instead: a full buffer is queued for it and filling goes on in the
+ * next one. There are only a few buffers, so when the standard output
+ * is slower than the events the event functions wait for a free one.
+ * Numbers are formatted by hand. The bytes written are the ones printf
+ * would give: OutputInt matches %d and OutputUnsigned matches %u.
+ *
+ * Nothing should be printed to stdout with stdio while the buffer is in
+ * use, the two would come out of order.
+*/
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+/*
+ * How much the events print:
+ *  full    every event prints the structures it changed, as a whole
+ *  delta   every event prints only what it changed
+ *  status  every event prints only its first line and DONE
+ * Events M, P and I print the whole structures in every mode.
+*/
+enum output_mode {
+    OUTPUT_FULL,
+    OUTPUT_DELTA,
+    OUTPUT_STATUS
+};
+
+extern enum output_mode output_mode;
+
+/*
+ * Select the output mode by name: "full", "delta" or "status".
+ * Returns 0 on success, -1 if the name is unknown.
+*/
+int OutputSelect(const char* name);
+
+/* Append the '\0' terminated string s */
+void OutputString(const char* s);
+
+/* Append the character c */
+void OutputChar(char c);
+
+/* Append n in decimal, as printf("%d") does */
+void OutputInt(int n);
+
+/* Append n in decimal, as printf("%u") does */
+void OutputUnsigned(unsigned n);
+
+/*
+ * Write the output from a thread of its own, see above.
+ * Returns 0 on success, -1 if the thread could not be started,
+ * in which case the output is written directly as before.
+*/
+int OutputStartWriter(void);
+
+/* Write out everything appended so far, and wait until it is written. */
+void OutputFlush(void);
+
+/* Flush and stop the writer thread, if there is one. Must be called before main returns. */
+void OutputClose(void);
+
+#endif /* OUTPUT_H */
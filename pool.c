@@ -0,0 +1,115 @@
+/*
+ * Function definitions for the object pool declared in pool.h.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "pool.h"
+
+/* Target size of a slab in bytes */
+#define SLAB_BYTES 65536
+
+/* Strictest alignment needed by the objects we keep in pools */
+union pool_align {
+    long l;
+    double d;
+    void* p;
+};
+
+/* Space taken by the slab header, so that the first object is aligned */
+#define SLAB_HEADER \
+    (((sizeof(struct pool_slab) + sizeof(union pool_align) - 1) \
+      / sizeof(union pool_align)) * sizeof(union pool_align))
+
+void PoolInit(struct pool* P, const char* name, size_t obj_size) {
+    size_t align = sizeof(union pool_align);
+
+    /* A free object must hold the free list pointer */
+    if (obj_size < sizeof(void*)) obj_size = sizeof(void*);
+
+    P->name = name;
+    P->obj_size = ((obj_size + align - 1) / align) * align;
+    P->per_slab = (SLAB_BYTES - SLAB_HEADER) / P->obj_size;
+    if (P->per_slab == 0) P->per_slab = 1;
+
+    P->slabs = NULL;
+    P->bump = P->bump_end = NULL;
+    P->free_list = NULL;
+    P->live = P->peak = P->capacity = P->nslabs = 0;
+}
+
+/* Allocate a new slab and make it the one we carve objects from. */
+static int NewSlab(struct pool* P) {
+    struct pool_slab* slab;
+
+    slab = (struct pool_slab*) malloc(SLAB_HEADER + P->per_slab * P->obj_size);
+    if (slab == NULL) return -1;
+
+    slab->next = P->slabs;
+    P->slabs = slab;
+
+    P->bump = (char*)slab + SLAB_HEADER;
+    P->bump_end = P->bump + P->per_slab * P->obj_size;
+
+    P->nslabs++;
+    P->capacity += P->per_slab;
+
+    return 0;
+}
+
+void* PoolAlloc(struct pool* P) {
+    void* obj;
+
+#ifdef NO_POOL
+    obj = malloc(P->obj_size);
+    if (obj == NULL) return NULL;
+#else
+    if (P->free_list != NULL) {             /* Reuse a freed object */
+        obj = P->free_list;
+        P->free_list = *(void**)obj;
+    }
+    else {                                  /* Carve a new one */
+        if (P->bump == P->bump_end && NewSlab(P) == -1) return NULL;
+        obj = P->bump;
+        P->bump += P->obj_size;
+    }
+#endif /* NO_POOL */
+
+    if (++P->live > P->peak) P->peak = P->live;
+
+    return obj;
+}
+
+void PoolFree(struct pool* P, void* obj) {
+    if (obj == NULL) return;
+
+#ifdef NO_POOL
+    free(obj);
+#else
+    *(void**)obj = P->free_list;
+    P->free_list = obj;
+#endif /* NO_POOL */
+    P->live--;
+}
+
+void PoolDestroy(struct pool* P) {
+    struct pool_slab* slab = P->slabs;
+    struct pool_slab* n = NULL;
+
+    while (slab != NULL) {
+        n = slab->next;
+        free(slab);
+        slab = n;
+    }
+
+    P->slabs = NULL;
+    P->bump = P->bump_end = NULL;
+    P->free_list = NULL;
+    P->live = P->capacity = P->nslabs = 0;
+}
+
+void PoolPrintStats(const struct pool* P, FILE* out) {
+    fprintf(out, "%s pool: %lu/%lu objects in use (%.1f%%), peak %lu, %lu slabs of %lu x %lu bytes\n",
+            P->name, P->live, P->capacity,
+            (P->capacity > 0) ? (100.0 * P->live / P->capacity) : 0.0,
+            P->peak, P->nslabs, (unsigned long)P->per_slab, (unsigned long)P->obj_size);
+}
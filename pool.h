@@ -0,0 +1,52 @@
+/*
+ * Fixed size object pool. Objects are carved out of large contiguous
+ * slabs and freed objects are kept in a free list for reuse, so list
+ * nodes do not go through malloc/free one by one.
+ * Slabs are only returned to the system by PoolDestroy.
+ *
+ * Compile with -DNO_POOL to get every object from malloc instead,
+ * so that memory checkers can track them one by one.
+*/
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* Slab header, the objects follow it */
+struct pool_slab {
+    struct pool_slab* next;
+};
+
+struct pool {
+    const char* name;           /* Used when printing the stats */
+    size_t obj_size;            /* Object size, rounded up for alignment */
+    size_t per_slab;            /* Number of objects in each slab */
+    struct pool_slab* slabs;    /* All slabs allocated so far */
+    char* bump;                 /* Next never used object of the newest slab */
+    char* bump_end;             /* End of the newest slab */
+    void* free_list;            /* Objects given back by PoolFree */
+
+    /* Occupancy stats */
+    unsigned long live;         /* Objects currently in use */
+    unsigned long peak;         /* Max value of live so far */
+    unsigned long capacity;     /* Objects in all slabs */
+    unsigned long nslabs;       /* Number of slabs */
+};
+
+/* Initialize an empty pool for objects of obj_size bytes. */
+void PoolInit(struct pool* P, const char* name, size_t obj_size);
+
+/* Returns an object of the pool, NULL on malloc error. */
+void* PoolAlloc(struct pool* P);
+
+/* Give obj, allocated by PoolAlloc of the same pool, back to the pool. */
+void PoolFree(struct pool* P, void* obj);
+
+/* Deallocate every slab. All objects of the pool become invalid. */
+void PoolDestroy(struct pool* P);
+
+/* Print the occupancy stats of the pool in one line. */
+void PoolPrintStats(const struct pool* P, FILE* out);
+
+#endif /* POOL_H */
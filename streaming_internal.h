@@ -0,0 +1,34 @@
+/*
+ * Declarations of helper functions of streaming_service.c that are
+ * used outside of it, by the benchmarks in bench/.
+ * The definitions are in streaming_service.c
+*/
+#ifndef STREAMING_INTERNAL_H
+#define STREAMING_INTERNAL_H
+
+#include "streaming_service.h"
+
+/* New movies: staged by event A, sorted into new_movies_list when needed */
+int NewMoviesStage(unsigned mid, movieCategory_t cat, unsigned year);
+int NewMoviesFlush(void);
+
+/* Category lists: the sorted arrays of the category table */
+int CategoryReserve(struct category_list* L, unsigned n);
+void CategoryMerge(struct category_list* L, const unsigned* nmids, const unsigned* nyears, unsigned m);
+struct movie_info CategoryListSearch(const struct category_list* L, unsigned mid);
+
+/* Split new_movies_list and merge it into the category array (event D) */
+void split_list(void);
+
+/* Watch stack */
+int Push(struct movie** S, struct movie_info minfo);
+struct movie_info Pop(struct movie** S);
+
+/* Suggested lists: DLLs of segments, whose movies are chained in suggestion_index */
+int SuggestAround(struct user* u, const struct movie_info* right, unsigned nr,
+                  const struct movie_info* left, unsigned nl);
+int AppendSuggested(struct user* u, const struct movie_info* infos, unsigned n,
+                    struct sugg_segment** first, unsigned* first_pos);
+void SuggestedErase(struct suggested_movie* node, unsigned mid);
+
+#endif /* STREAMING_INTERNAL_H */
@@ -10,83 +10,512 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include "streaming_service.h"
+#include "streaming_internal.h"
+#include "year_filter.h"
+#include "output.h"
+#include "mem_account.h"
+
+/*
+ * Memory of the structures not kept in a pool, see MEMORY REPORT.
+ * Nodes are movies for the category lists and the year index,
+ * entries for movie_index.
+*/
+static struct mem_account category_memory;
+static struct mem_account year_index_memory;
+static struct mem_account catalog_memory;
+
+/* See streaming_service.h */
+int dedupe_suggestions = 0;
 
 /*
  ******************************************************************************
- ********************************* USER LIST ********************************
+ ***************************** SUGGESTION INDEX *******************************
  ******************************************************************************
 */
 
 /*
- * Search in user list for a specific uid.
- * Returns 1 if the uid is already inside the list, 0 otherwise.
+ * Chain node, a suggested movie with mid, to the other ones with the same mid.
+ * Returns 0 on success, -1 otherwise.
 */
-int UserListSearch(int uid) {
-    /* Insert the value inside the guard node*/
-    guard->uid = uid;
+int SuggIndexAdd(struct suggested_movie* node, unsigned mid) {
+    struct suggested_movie* first;
     
-    struct user* tmp = user_list;
-    while (tmp->uid != uid) {
-        tmp = tmp->next;
+    first = (struct suggested_movie*) HashTableFind(&suggestion_index, mid);
+
+    node->ref_prev = NULL;
+    node->ref_next = NULL;
+
+    /* First node with this mid */
+    if (first == NULL) {
+        return (HashTableInsert(&suggestion_index, mid, node) == 0) ? 0 : -1;
     }
 
-    /* Bring guard back to initial state*/
-    guard->uid = -1;
+    /* Place node after the first one, so the table does not change */
+    node->ref_prev = first;
+    node->ref_next = first->ref_next;
+    if (first->ref_next != NULL) first->ref_next->ref_prev = node;
+    first->ref_next = node;
 
-    return (tmp != guard); /* True if value was not found. */
+    return 0;
 }
 
-/* Returns a pointer to the node of user_list with id uid, else NULL*/
-struct user* FindUserList(int uid) {
-    /* Insert the value inside the guard node*/
-    guard->uid = uid;
-    
-    struct user* tmp = user_list;
-    while (tmp->uid != uid) {
+/* Unchain node, a suggested movie with mid, from the other ones with the same mid. */
+void SuggIndexRemove(struct suggested_movie* node, unsigned mid) {
+    if (node->ref_next != NULL) node->ref_next->ref_prev = node->ref_prev;
+
+    if (node->ref_prev != NULL) {           /* node is a regular node */
+        node->ref_prev->ref_next = node->ref_next;
+    }
+    else if (node->ref_next != NULL) {      /* node is the first one */
+        HashTableReplace(&suggestion_index, mid, node->ref_next);
+    }
+    else {                                  /* node is the only one */
+        HashTableRemove(&suggestion_index, mid);
+    }
+}
+
+/*
+ ******************************************************************************
+ ******************************* SUGGESTED LIST *******************************
+ ******************************************************************************
+*/
+
+/* Room left between the seq of consecutive segments, see SuggSegmentLabel() */
+#define SUGG_SEQ_STEP (1UL << (sizeof(unsigned long) * CHAR_BIT / 2))
+
+/* Position of suggested movie node in its segment */
+static unsigned SuggPos(const struct suggested_movie* node) {
+    const struct sugg_segment* seg = node->segment;
+    unsigned char s = (unsigned char)(node - seg->refs);
+    unsigned i = 0;
+
+    while (seg->slot[i] != s) ++i;
+    return i;
+}
+
+/* Returns 1 if suggested movie x comes before y, of the same list, 0 otherwise */
+static int SuggBefore(const struct suggested_movie* x, const struct suggested_movie* y) {
+    if (x->segment != y->segment) return (x->segment->seq < y->segment->seq);
+    return (SuggPos(x) < SuggPos(y));
+}
+
+/*
+ * Move the movie at from->info[i] to the free place to->info[j] of
+ * another segment, and point its chain of suggestion_index to its new slot.
+*/
+static void SuggMove(struct sugg_segment* to, unsigned j, struct sugg_segment* from, unsigned i) {
+    struct suggested_movie* node = &to->refs[to->slot[j]];
+
+    to->info[j] = from->info[i];
+    (*node) = from->refs[from->slot[i]];
+    node->segment = to;
+
+    if (node->ref_next != NULL) node->ref_next->ref_prev = node;
+    if (node->ref_prev != NULL) node->ref_prev->ref_next = node;
+    else HashTableReplace(&suggestion_index, to->info[j].mid, node);
+}
+
+/*
+ * Give segment seg, just linked, a seq between the ones of its neighbours.
+ * When they are too close, seg and the segments after it are spread over
+ * the first range wide enough for them, or the whole list is relabelled.
+*/
+static void SuggSegmentLabel(struct sugg_segment* seg) {
+    struct sugg_segment* tmp = seg->next;
+    unsigned long low = (seg->prev != NULL) ? seg->prev->seq : 0;
+    unsigned long high, step;
+    unsigned long k = 1;    /* Segments from seg to label between low and high */
+
+    for (;;) {
+        high = (tmp != NULL) ? tmp->seq : ULONG_MAX;
+        step = (high - low) / (k + 1);
+        if (step > SUGG_SEQ_STEP) step = SUGG_SEQ_STEP;
+        if (step > k) break;
+
+        if (tmp == NULL) {
+            for (k = 0, tmp = seg->owner->suggestedHead; tmp != NULL; tmp = tmp->next) k++;
+            seg = seg->owner->suggestedHead;
+            low = 0;
+            step = ULONG_MAX / (k + 1);
+            if (step > SUGG_SEQ_STEP) step = SUGG_SEQ_STEP;
+            break;
+        }
+
         tmp = tmp->next;
+        k++;
     }
 
-    /* Bring guard back to initial state*/
-    guard->uid = -1;
+    for (; k > 0; --k, seg = seg->next) {
+        low += step;
+        seg->seq = low;
+    }
+}
+
+/* Link the empty segment seg to the suggested list of owner, after prev (NULL for the head) */
+static void SuggSegmentLink(struct sugg_segment* seg, struct user* owner, struct sugg_segment* prev) {
+    unsigned i;
+
+    for (i = 0; i < SUGG_SEGMENT; ++i) seg->slot[i] = (unsigned char)i;
+    seg->count = 0;
+    seg->owner = owner;
+    seg->prev = prev;
+    seg->next = (prev != NULL) ? prev->next : owner->suggestedHead;
+
+    if (seg->next != NULL) seg->next->prev = seg;
+    else owner->suggestedTail = seg;
+
+    if (prev != NULL) prev->next = seg;
+    else owner->suggestedHead = seg;
 
-    return (tmp != guard) ? tmp : NULL;
+    SuggSegmentLabel(seg);
+}
+
+/* Unlink segment seg from its suggested list and deallocate it */
+static void SuggSegmentFree(struct sugg_segment* seg) {
+    struct user* owner = seg->owner;
+
+    if (seg->prev != NULL) seg->prev->next = seg->next;
+    else owner->suggestedHead = seg->next;
+
+    if (seg->next != NULL) seg->next->prev = seg->prev;
+    else owner->suggestedTail = seg->prev;
+
+    PoolFree(&suggested_pool, seg);
+}
+
+/* Shift the movies of segment seg k places right in info[] and slot[], which must fit */
+static void SuggShiftRight(struct sugg_segment* seg, unsigned k) {
+    unsigned char order[SUGG_SEGMENT];
+
+    memcpy(order, &seg->slot[seg->count], k);
+    memcpy(&order[k], seg->slot, seg->count);
+    memcpy(&order[k + seg->count], &seg->slot[seg->count + k], SUGG_SEGMENT - seg->count - k);
+    memcpy(seg->slot, order, SUGG_SEGMENT);
+    memmove(&seg->info[k], seg->info, seg->count * sizeof(struct movie_info));
+}
+
+/*
+ * Merge segment seg and the one after it, which must fit in one.
+ * The movies of the smaller one move to the other.
+*/
+static void SuggMergeNext(struct sugg_segment* seg) {
+    struct sugg_segment* next = seg->next;
+    unsigned i;
+
+    if (seg->count >= next->count) {
+        for (i = 0; i < next->count; ++i) SuggMove(seg, seg->count + i, next, i);
+        seg->count += next->count;
+        SuggSegmentFree(next);
+        return;
+    }
+
+    SuggShiftRight(next, seg->count);
+    for (i = 0; i < seg->count; ++i) SuggMove(next, i, seg, i);
+    next->count += seg->count;
+    SuggSegmentFree(seg);
+}
+
+/*
+ * Insert the n movies of infos, in order, to the suggested list of owner
+ * before the movie at position pos of segment seg (pos == seg->count for
+ * after its last movie). seg is NULL only for an empty list.
+ * The movies of seg after pos are shifted to make room. When seg fills
+ * up they go to the front of the next segment if it has room, to new
+ * segments otherwise. Only the ones that leave seg move their
+ * suggestion_index node. Every allocation is made first, so a failure
+ * leaves the list as it was.
+ * Returns 0 on success, -1 otherwise.
+*/
+int SuggestedInsert(struct user* owner, struct sugg_segment* seg, unsigned pos,\
+                    const struct movie_info* infos, unsigned n) {
+    struct sugg_segment* fresh = NULL;  /* New segments, not linked yet */
+    struct sugg_segment* last;          /* Last segment holding the movies after pos */
+    struct sugg_segment* tmp;
+    struct suggested_movie* node;
+    unsigned char order[SUGG_SEGMENT];  /* slot[] of seg after the insertion */
+    unsigned rest = (seg != NULL) ? seg->count - pos : 0;   /* Movies of seg after pos */
+    unsigned total = pos + n + rest;    /* Movies of seg and the new segments, at the end */
+    unsigned kept = 0;                  /* Movies after pos that stay in seg */
+    unsigned here;                      /* Movies of infos placed in seg */
+    unsigned after = 0;                 /* Movies of last after the ones placed */
+    unsigned extra, base, g, i;
+
+    if (n == 0) return 0;
+
+    /* What does not fit in seg goes to the front of the next segment if it has room */
+    if ((seg != NULL) && (seg->next != NULL) && (total > SUGG_SEGMENT) &&\
+        (seg->next->count + total - SUGG_SEGMENT <= SUGG_SEGMENT)) {
+        after = seg->next->count;
+    }
+
+    extra = (after > 0) ? 0 : (total - 1) / SUGG_SEGMENT + (seg == NULL);
+    if (HashTableReserve(&suggestion_index, n) == -1) return -1;
+    if (dedupe_suggestions && MidSetReserve(&owner->suggestedSet, n) == -1) return -1;
+    for (i = 0; i < extra; ++i) {
+        tmp = (struct sugg_segment*) PoolAlloc(&suggested_pool);
+        if (tmp == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            for (; fresh != NULL; fresh = tmp) {
+                tmp = fresh->next;
+                PoolFree(&suggested_pool, fresh);
+            }
+            /* The set of an empty list holds no memory, see CleanSuggestedMovies() */
+            if (owner->suggestedSet.size == 0) MidSetDestroy(&owner->suggestedSet);
+            return -1;
+        }
+        tmp->next = fresh;
+        fresh = tmp;
+    }
+
+    /* An empty list gets its first segment */
+    if (seg == NULL) {
+        seg = fresh;
+        fresh = fresh->next;
+        SuggSegmentLink(seg, owner, NULL);
+    }
+
+    for (last = seg; fresh != NULL; last = tmp) {
+        tmp = fresh;
+        fresh = fresh->next;
+        SuggSegmentLink(tmp, owner, last);
+    }
+
+    if (after > 0) {
+        last = seg->next;
+        SuggShiftRight(last, total - SUGG_SEGMENT);
+    }
+
+    /*
+     * Place g counts from the first movie of seg across the segments.
+     * The movies after pos that do not fit in seg any more move to
+     * their place in the new segments first.
+    */
+    if (pos + n < SUGG_SEGMENT) kept = (rest < SUGG_SEGMENT - pos - n) ? rest : SUGG_SEGMENT - pos - n;
+    here = (n < SUGG_SEGMENT - pos) ? n : SUGG_SEGMENT - pos;
+
+    tmp = last;
+    base = (total - 1) / SUGG_SEGMENT * SUGG_SEGMENT;
+    for (i = rest; i > kept; --i) {
+        g = pos + n + i - 1;
+        for (; g < base; base -= SUGG_SEGMENT) tmp = tmp->prev;
+        SuggMove(tmp, g - base, seg, pos + i - 1);
+    }
+
+    /*
+     * The ones that stay are shifted in info[] and slot[] only. The places
+     * from pos take free slots, those after the kept movies and the ones
+     * left by the movies that moved out.
+    */
+    memcpy(order, seg->slot, pos);
+    memcpy(&order[pos], &seg->slot[pos + kept], here);
+    memcpy(&order[pos + here], &seg->slot[pos], kept);
+    memcpy(&order[pos + here + kept], &seg->slot[pos + kept + here], SUGG_SEGMENT - pos - kept - here);
+    memcpy(seg->slot, order, SUGG_SEGMENT);
+    memmove(&seg->info[pos + here], &seg->info[pos], kept * sizeof(struct movie_info));
+
+    /* Then the movies of infos fill the places from pos, adding them can not fail now */
+    tmp = seg;
+    base = 0;
+    for (i = 0; i < n; ++i) {
+        g = pos + i;
+        if (g - base == SUGG_SEGMENT) {
+            tmp = tmp->next;
+            base += SUGG_SEGMENT;
+        }
+        tmp->info[g - base] = infos[i];
+        node = &tmp->refs[tmp->slot[g - base]];
+        node->segment = tmp;
+        SuggIndexAdd(node, infos[i].mid);
+        if (dedupe_suggestions) MidSetAdd(&owner->suggestedSet, infos[i].mid);
+    }
+
+    /* Every segment is full but the last */
+    for (tmp = seg, base = 0; tmp != last; tmp = tmp->next, base += SUGG_SEGMENT) {
+        tmp->count = SUGG_SEGMENT;
+    }
+    last->count = total - base + after;
+
+    /* Keep the small segments left by earlier inserts from piling up */
+    if ((last->next != NULL) && (last->count + last->next->count <= SUGG_SEGMENT)) {
+        SuggMergeNext(last);
+    }
+
+    return 0;
+}
+
+/*
+ * Append the n movies of infos to the suggested list of u.
+ * (*first, *first_pos) gets the place of the first of them,
+ * first is NULL if n is 0.
+ * Returns 0 on success, -1 otherwise (the list is not changed).
+*/
+int AppendSuggested(struct user* u, const struct movie_info* infos, unsigned n,\
+                    struct sugg_segment** first, unsigned* first_pos) {
+    struct sugg_segment* tail = u->suggestedTail;
+    unsigned count = (tail != NULL) ? tail->count : 0;
+
+    (*first) = NULL;
+    (*first_pos) = 0;
+    if (n == 0) return 0;
+
+    if (SuggestedInsert(u, tail, count, infos, n) == -1) return -1;
+
+    if (tail == NULL) {
+        (*first) = u->suggestedHead;
+    }
+    else if (count < SUGG_SEGMENT) {
+        (*first) = tail;
+        (*first_pos) = count;
+    }
+    else {
+        (*first) = tail->next;
+    }
+
+    return 0;
+}
+
+/*
+ * Remove suggested movie node, with mid, from its list and unchain it
+ * from suggestion_index. The movies after it in its segment are shifted left
+ * in info[] and slot[], its slot becomes free. An emptied segment is
+ * freed and one left with at most SUGG_MERGE movies is merged into a
+ * neighbour it fits in.
+*/
+void SuggestedErase(struct suggested_movie* node, unsigned mid) {
+    struct sugg_segment* seg = node->segment;
+    unsigned pos = SuggPos(node);
+    unsigned char s = seg->slot[pos];
+
+    if (dedupe_suggestions) MidSetRemove(&seg->owner->suggestedSet, mid);
+    SuggIndexRemove(node, mid);
+
+    seg->count--;
+    memmove(&seg->info[pos], &seg->info[pos + 1], (seg->count - pos) * sizeof(struct movie_info));
+    memmove(&seg->slot[pos], &seg->slot[pos + 1], seg->count - pos);
+    seg->slot[seg->count] = s;
+
+    if (seg->count == 0) {
+        SuggSegmentFree(seg);
+        return;
+    }
+
+    if (seg->count > SUGG_MERGE) return;
+
+    if ((seg->next != NULL) && (seg->count + seg->next->count <= SUGG_SEGMENT)) {
+        SuggMergeNext(seg);
+    }
+    else if ((seg->prev != NULL) && (seg->prev->count + seg->count <= SUGG_SEGMENT)) {
+        SuggMergeNext(seg->prev);
+    }
+}
+
+/*
+ * Returns 1 if mid is new both to the suggested list of u and to seen,
+ * the movies an event picked for u so far, and adds it to seen.
+ * Returns 0 otherwise. seen must have room reserved for mid.
+*/
+int SuggestedIsNew(const struct user* u, struct mid_set* seen, unsigned mid) {
+    if ((MidSetCount(&u->suggestedSet, mid) != 0) || (MidSetCount(seen, mid) != 0)) return 0;
+
+    MidSetAdd(seen, mid);
+    return 1;
+}
+
+/*
+ * Drop from infos[0..*n) the movies that are not new to the suggested
+ * list of u or to the movies before them, keeping the order of the rest.
+ * *n gets the number of movies left.
+ * Returns 0 on success, -1 otherwise.
+*/
+int SuggestedDedupe(const struct user* u, struct movie_info* infos, unsigned* n) {
+    struct mid_set seen;
+    unsigned i, k = 0;
+
+    MidSetInit(&seen);
+    if (MidSetReserve(&seen, *n) == -1) return -1;
+
+    for (i = 0; i < *n; ++i) {
+        if (SuggestedIsNew(u, &seen, infos[i].mid)) infos[k++] = infos[i];
+    }
+
+    MidSetDestroy(&seen);
+    (*n) = k;
+    return 0;
+}
+
+/*
+ ******************************************************************************
+ ********************************* USER LIST ********************************
+ ******************************************************************************
+*/
+
+/*
+ * Search in user list for a specific uid.
+ * Returns 1 if the uid is already inside the list, 0 otherwise.
+ * Time complexity: O(1) on average, using user_index.
+*/
+int UserListSearch(int uid) {
+    return (HashTableFind(&user_index, (unsigned)uid) != NULL);
+}
+
+/* Returns a pointer to the node of user_list with id uid, else NULL*/
+struct user* FindUserList(int uid) {
+    return (struct user*) HashTableFind(&user_index, (unsigned)uid);
 }
 
  /* Insert new user to the user list. Returns 0 on success, -1 otherwise. */
 int UserListInsert(int uid) {
-    struct user* new_user = (struct user*) malloc(sizeof(struct user));
+    static unsigned long registrations = 0;
+    struct user* new_user;
+
+    /* Check if uid is already inside the list*/
+    if (UserListSearch(uid)) {
+        fprintf(stderr, "User %d is already in the list\n", uid);
+        return -1;
+    }
+
+    new_user = (struct user*) PoolAlloc(&user_pool);
     if (new_user == NULL) {
         fprintf(stderr, "Malloc error\n");
         return -1;
     }
     new_user->uid = uid;
+    new_user->order = ++registrations;
     new_user->suggestedHead = NULL;
     new_user->suggestedTail = NULL;
+    MidSetInit(&new_user->suggestedSet);
     new_user->watchHistory = NULL;
 
-    /* Check if uid is already inside the list*/
-    if (UserListSearch(uid)) {
-        fprintf(stderr, "User %d is already in the list\n", uid);
+    if (HashTableInsert(&user_index, (unsigned)uid, new_user) == -1) {
+        PoolFree(&user_pool, new_user);
         return -1;
     }
 
     /* Insert new user at the head of the list. */
+    new_user->prev = NULL;
     new_user->next = user_list;
+    user_list->prev = new_user; /* user_list is at least the guard */
     user_list = new_user;
     
     return 0;
 }
 
-/* Deallocate all nodes from the suggested movie list given*/
-void CleanSuggestedMovies(struct suggested_movie** head, struct suggested_movie** tail) {
-    struct suggested_movie* n; /* Next */
-    struct suggested_movie* tmp = (*head);
+/* Deallocate all segments from the suggested movie list given, and the set of its mids*/
+void CleanSuggestedMovies(struct sugg_segment** head, struct sugg_segment** tail) {
+    struct sugg_segment* n; /* Next */
+    struct sugg_segment* tmp = (*head);
+    unsigned i;
+
+    /* The set of an empty list holds no memory */
+    if (tmp != NULL) MidSetDestroy(&tmp->owner->suggestedSet);
 
     while (tmp != NULL) {
         n = tmp->next;
-        free(tmp);
+        for (i = 0; i < tmp->count; ++i) SuggIndexRemove(&tmp->refs[tmp->slot[i]], tmp->info[i].mid);
+        PoolFree(&suggested_pool, tmp);
         tmp = n;
     }
 
@@ -94,52 +523,47 @@ void CleanSuggestedMovies(struct suggested_movie** head, struct suggested_movie*
     (*tail) = NULL;
 }
 
-/* Deallocate all stack nodes and the stack. */
+/* Deallocate all stack chunks and the stack. */
 void CleanStack(struct movie** S) {
-    struct movie* n;            /* next node */
-    struct movie* tmp = (*S);   /* save the head */
+    struct movie* n;            /* next chunk */
+    struct movie* tmp = (*S);   /* save the top chunk */
 
     while (tmp != NULL) {
         n = tmp->next;  /* save next node */
-        free(tmp);      /* deallocate */
+        PoolFree(&movie_pool, tmp); /* deallocate */
         tmp = n;
     }
 
     (*S) = NULL;
 }
 
-/* Remove a user from the user_list and deallocate suggested DLL and stack */
-void DeleteUser(int uid) {
-    struct user* tmp = user_list;
-    struct user* prev = NULL;
-    
-    /* Search for uid */
-    guard->uid = uid;
-    while (tmp->uid != uid) {
-        prev = tmp;
-        tmp = tmp->next;
-    }
-
-    guard->uid = -1; /* Restore guard value*/
+/*
+ * Remove a user from the user_list and deallocate suggested list and stack.
+ * Returns 0 on success, -1 if the user does not exist.
+*/
+int DeleteUser(int uid) {
+    struct user* tmp = (struct user*) HashTableRemove(&user_index, (unsigned)uid);
 
     /* User does not exist*/
-    if (tmp == guard) {
+    if (tmp == NULL) {
         fprintf(stderr, "User %d does not exist\n", uid);   
-        return;
+        return -1;
     }
     
-    /* Clean suggested movies DLL and watchHistory */
+    /* Clean suggested movies list and watchHistory */
     CleanSuggestedMovies(&tmp->suggestedHead, &tmp->suggestedTail);
     CleanStack(&tmp->watchHistory);
 
-    if (tmp == user_list) {     /* uid is the head node */
+    if (tmp->prev == NULL) {    /* uid is the head node */
         user_list = tmp->next;  /* Update list head*/
     }
     else {                      /* uid is a regular node*/
-        prev->next = tmp->next;
+        tmp->prev->next = tmp->next;
     }
+    tmp->next->prev = tmp->prev; /* next is at least the guard */
     
-    free(tmp);
+    PoolFree(&user_pool, tmp);
+    return 0;
 }
 
 /*
@@ -149,27 +573,23 @@ void DeleteUser(int uid) {
 */
 
 /*
- * Insert new movies to new_movies_list in ascending order based on mid.
+ * Stage a new movie: it is added to the front of staged_movies,
+ * unsorted, and to new_movie_index. Staged movies join new_movies_list
+ * when it is next needed, see NewMoviesFlush().
  * Returns 0 on success, -1 otherwise.
+ * Time complexity: O(1) on average
 */
-int NewMoviesInsertSorted(unsigned mid, movieCategory_t cat, unsigned year) {
-    struct new_movie *prev = NULL;              /* parent of new node */
-    struct new_movie *tmp = new_movies_list;    /* node used for scanning */
-
-    /* Scan the list to find the right place*/
-    while ((tmp!= NULL) && (tmp->info.mid < mid)) {
-        prev = tmp;
-        tmp = tmp->next;
-    }
+int NewMoviesStage(unsigned mid, movieCategory_t cat, unsigned year) {
+    struct new_movie* new_film;
 
     /* We don't allow duplicate movies*/ 
-    if ((tmp!= NULL) && (tmp->info.mid == mid)) {
+    if (HashTableFind(&new_movie_index, mid) != NULL) {
         fprintf(stderr, "Movie %d is already inside.\n", mid);
         return -1;
     }
 
     /* Create and initialize the new node*/
-    struct new_movie* new_film = (struct new_movie*)malloc(sizeof(struct new_movie));
+    new_film = (struct new_movie*)PoolAlloc(&new_movie_pool);
     if (new_film == NULL) {
         fprintf(stderr, "Malloc error\n");
         return -1;
@@ -178,32 +598,111 @@ int NewMoviesInsertSorted(unsigned mid, movieCategory_t cat, unsigned year) {
     new_film->info.year = year;
     new_film->category = cat;
 
-    /* 
-     * If tmp != NULL then tmp's mid > mid.
-     * If tmp == NULL (empty list or end of list found) then mid is the largest.
-    */
-    new_film->next = tmp;
-    
-    /* (mid < head's mid) OR (empty list)*/
-    if (prev == NULL) {
-        new_movies_list = new_film; /* Replace list's head*/
+    if (HashTableInsert(&new_movie_index, mid, new_film) != 0) {
+        fprintf(stderr, "Malloc error\n");
+        PoolFree(&new_movie_pool, new_film);
+        return -1;
     }
-    else {
-        /* Insert new node between prev and tmp */
-        prev->next = new_film;
+
+    new_film->next = staged_movies;
+    staged_movies = new_film;
+
+    return 0;
+}
+
+/*
+ * LSD radix sort of the n new movies of a by mid, one byte per pass.
+ * Passes where every mid has the same byte are skipped.
+ * tmp must have room for n pointers. The result ends up in a.
+ * Time complexity: O(n)
+*/
+void RadixSortNewMovies(struct new_movie** a, struct new_movie** tmp, unsigned n) {
+    unsigned counts[256];
+    struct new_movie** src = a;
+    struct new_movie** dst = tmp;
+    struct new_movie** swap;
+    unsigned shift, i, sum, c;
+
+    for (shift = 0; shift < 32; shift += 8) {
+        for (i = 0; i < 256; ++i) counts[i] = 0;
+        for (i = 0; i < n; ++i) counts[(src[i]->info.mid >> shift) & 0xFF]++;
+
+        if (n == 0 || counts[(src[0]->info.mid >> shift) & 0xFF] == n) continue;
+
+        /* Turn the counts to starting positions */
+        for (i = 0, sum = 0; i < 256; ++i) {
+            c = counts[i];
+            counts[i] = sum;
+            sum += c;
+        }
+        for (i = 0; i < n; ++i) dst[counts[(src[i]->info.mid >> shift) & 0xFF]++] = src[i];
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != a) memcpy(a, src, n * sizeof(struct new_movie*));
+}
+
+/*
+ * Sort staged_movies by mid and merge them into new_movies_list,
+ * which stays sorted. Needed before new_movies_list is printed or distributed.
+ * Returns 0 on success, -1 otherwise (the movies stay staged).
+ * Time complexity: O(N + S), N the size of new_movies_list, S the staged movies
+*/
+int NewMoviesFlush(void) {
+    struct new_movie** staged;
+    struct new_movie* tmp = staged_movies;
+    struct new_movie* old = new_movies_list;
+    struct new_movie head;      /* Dummy head of the merged list */
+    struct new_movie* tail = &head;
+    unsigned n = 0;
+    unsigned i = 0;
+
+    if (staged_movies == NULL) return 0;
+
+    for (tmp = staged_movies; tmp != NULL; tmp = tmp->next) n++;
+
+    staged = (struct new_movie**) malloc(2 * n * sizeof(struct new_movie*));
+    if (staged == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return -1;
     }
+    for (tmp = staged_movies; tmp != NULL; tmp = tmp->next) staged[i++] = tmp;
+
+    RadixSortNewMovies(staged, staged + n, n);
 
+    /* Merge the sorted staged movies with new_movies_list */
+    i = 0;
+    while (old != NULL || i < n) {
+        if (i == n || (old != NULL && old->info.mid < staged[i]->info.mid)) {
+            tail->next = old;
+            old = old->next;
+        }
+        else {
+            tail->next = staged[i++];
+        }
+        tail = tail->next;
+    }
+    tail->next = NULL;
+
+    new_movies_list = head.next;
+    staged_movies = NULL;
+
+    free(staged);
     return 0;
 }
 
-/* Deallocate all nodes of the new movies list given. */
+/* Deallocate all nodes of the new movies list given and their new_movie_index entries. */
 void CleanNewMoviesList(struct new_movie** L) {
     struct new_movie* tmp = (*L);
     struct new_movie* n = NULL;
 
     while (tmp != NULL) {
         n = tmp->next;
-        free(tmp);
+        HashTableRemove(&new_movie_index, tmp->info.mid);
+        PoolFree(&new_movie_pool, tmp);
         tmp = n;
     }
 
@@ -216,122 +715,442 @@ void CleanNewMoviesList(struct new_movie** L) {
  ******************************************************************************
 */
 
-/* 
- * Given the head and the tail of a struct movie SLL, creates a node 
- * with mid mid and year year and place it at the end of the SLL.
+/*
+ * Make room for at least n movies in category list L.
+ * The capacity is doubled, so appends cost amortized O(1).
  * Returns 0 on success, -1 otherwise.
- * Time complexity: O(1)
 */
-int insert_end(struct movie** head, struct movie** tail, unsigned mid, unsigned year) {
-	/* Node of category list*/
-	struct movie* new_node = (struct movie*)malloc(sizeof(struct movie));
-	if(new_node == NULL) {
-		fprintf(stderr, "Malloc error\n");
-		return -1;
-	}
-	new_node->info.mid = mid;
-	new_node->info.year = year;
+int CategoryReserve(struct category_list* L, unsigned n) {
+    unsigned new_cap = (L->capacity > 0) ? L->capacity : 16;
+    unsigned* mids;
+    unsigned* years;
 
-    if ((*head == NULL) && (*tail == NULL)) { /* Empty list */
-        *head = *tail = new_node;
+    if (n <= L->capacity) return 0;
+
+    while (new_cap < n) new_cap <<= 1;
+
+    /* Allocate both arrays before touching L, so a failure leaves it as it was */
+    mids = (unsigned*) malloc(new_cap * sizeof(unsigned));
+    years = (unsigned*) malloc(new_cap * sizeof(unsigned));
+    if (mids == NULL || years == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        free(mids);
+        free(years);
+        return -1;
     }
-    else {
-        (*tail)->next = new_node;
-        (*tail) = new_node;
+
+    if (L->size > 0) {
+        memcpy(mids, L->mids, L->size * sizeof(unsigned));
+        memcpy(years, L->years, L->size * sizeof(unsigned));
     }
+    free(L->mids);
+    free(L->years);
+    L->mids = mids;
+    L->years = years;
 
-    new_node->next = NULL; /* Because it is placed at the tail */
+    MemAccountAdd(&category_memory, 0, 2 * (new_cap - L->capacity) * sizeof(unsigned));
+    L->capacity = new_cap;
+    return 0;
+}
+
+/*
+ * Binary search for year in the year index of category list L.
+ * Returns the position of the first bucket with year >= year.
+ * Time complexity: O(log Y), Y the number of distinct years
+*/
+unsigned YearIndexFirst(const struct category_list* L, unsigned year) {
+    unsigned lo = 0;
+    unsigned hi = L->nbuckets;
+    unsigned m;
+
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        if (L->buckets[m].year < year) lo = m + 1;
+        else hi = m;
+    }
 
-	return 0;
+    return lo;
 }
 
 /*
- * Split new_movies_list and place it to the category array.
- * Time complexity: O(N)
+ * Returns the bucket of year in the year index of category list L.
+ * If there is none, an empty one is created when create is set.
+ * Returns NULL if the bucket does not exist or on malloc error.
 */
-void split_list() {
+struct year_bucket* YearBucketFind(struct category_list* L, unsigned year, int create) {
+    unsigned b = YearIndexFirst(L, year);
+    struct year_bucket* buckets;
+    unsigned new_cap;
+
+    if (b < L->nbuckets && L->buckets[b].year == year) return &L->buckets[b];
+    if (!create) return NULL;
+
+    if (L->nbuckets == L->bucket_capacity) {
+        new_cap = (L->bucket_capacity > 0) ? 2 * L->bucket_capacity : 8;
+        buckets = (struct year_bucket*) realloc(L->buckets, new_cap * sizeof(struct year_bucket));
+        if (buckets == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            return NULL;
+        }
+        L->buckets = buckets;
+        MemAccountAdd(&year_index_memory, 0, (new_cap - L->bucket_capacity) * sizeof(struct year_bucket));
+        L->bucket_capacity = new_cap;
+    }
+
+    /* Shift the later years one place to the right */
+    memmove(&L->buckets[b + 1], &L->buckets[b], (L->nbuckets - b) * sizeof(struct year_bucket));
+    L->nbuckets++;
+
+    L->buckets[b].year = year;
+    L->buckets[b].mids = NULL;
+    L->buckets[b].size = L->buckets[b].sorted = L->buckets[b].capacity = 0;
+
+    return &L->buckets[b];
+}
+
+/*
+ * Add mid at the end of bucket B of a year index. The bucket is
+ * left unsorted until YearIndexMerge() is called.
+ * Returns 0 on success, -1 otherwise.
+ * Time complexity: amortized O(1)
+*/
+int YearBucketAppend(struct year_bucket* B, unsigned mid) {
+    unsigned new_cap;
+    unsigned* mids;
+
+    if (B->size == B->capacity) {
+        new_cap = (B->capacity > 0) ? 2 * B->capacity : 4;
+        mids = (unsigned*) realloc(B->mids, new_cap * sizeof(unsigned));
+        if (mids == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            return -1;
+        }
+        B->mids = mids;
+        MemAccountAdd(&year_index_memory, 0, (new_cap - B->capacity) * sizeof(unsigned));
+        B->capacity = new_cap;
+    }
+
+    B->mids[B->size++] = mid;
+    MemAccountAdd(&year_index_memory, 1, 0);
+    return 0;
+}
+
+/*
+ * Merge the mids appended to each bucket of the year index of
+ * category list L (which are sorted, as they were appended in mid order)
+ * with the older ones. scratch needs room for the largest number of
+ * mids appended to a bucket.
+ * Time complexity: O(size of the touched buckets)
+*/
+void YearIndexMerge(struct category_list* L, unsigned* scratch) {
+    struct year_bucket* B;
+    unsigned b, i, j, k;
+
+    for (b = 0; b < L->nbuckets; ++b) {
+        B = &L->buckets[b];
+
+        /* Nothing to do if the appended mids are already larger */
+        if (B->sorted == 0 || B->sorted == B->size || B->mids[B->sorted - 1] < B->mids[B->sorted]) {
+            B->sorted = B->size;
+            continue;
+        }
+
+        /* Merge from the end, the appended mids are moved aside first */
+        j = B->size - B->sorted;
+        memcpy(scratch, &B->mids[B->sorted], j * sizeof(unsigned));
+        i = B->sorted;
+        k = B->size;
+        while (j > 0) {
+            if (i > 0 && B->mids[i - 1] > scratch[j - 1]) B->mids[--k] = B->mids[--i];
+            else B->mids[--k] = scratch[--j];
+        }
+
+        B->sorted = B->size;
+    }
+}
+
+/*
+ * Remove mid from the bucket of year in the year index of category list L.
+ * The bucket is dropped when it becomes empty.
+*/
+void YearIndexRemove(struct category_list* L, unsigned mid, unsigned year) {
+    struct year_bucket* B = YearBucketFind(L, year, 0);
+    unsigned lo = 0, hi, m;
+
+    if (B == NULL) return;
+
+    hi = B->size;
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        if (B->mids[m] < mid) lo = m + 1;
+        else hi = m;
+    }
+    if (lo == B->size || B->mids[lo] != mid) return;
+
+    memmove(&B->mids[lo], &B->mids[lo + 1], (B->size - lo - 1) * sizeof(unsigned));
+    B->size--;
+    B->sorted--;
+    MemAccountSub(&year_index_memory, 1, 0);
+
+    if (B->size == 0) {
+        MemAccountSub(&year_index_memory, 0, B->capacity * sizeof(unsigned));
+        free(B->mids);
+        memmove(B, B + 1, (L->nbuckets - (unsigned)(B - L->buckets) - 1) * sizeof(struct year_bucket));
+        L->nbuckets--;
+    }
+}
+
+/*
+ * Add movie minfo of category cat to movie_index, after the entries
+ * of the same mid in categories up to cat.
+ * Returns 0 on success, -1 otherwise.
+*/
+int MovieIndexInsert(struct movie_info minfo, movieCategory_t cat) {
+    struct catalog_entry* head = (struct catalog_entry*) HashTableFind(&movie_index, minfo.mid);
+    struct catalog_entry* prev = NULL;
+    struct catalog_entry* entry = (struct catalog_entry*)malloc(sizeof(struct catalog_entry));
+    if (entry == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return -1;
+    }
+    entry->info = minfo;
+    entry->category = cat;
+
+    entry->next = head;
+    while (entry->next != NULL && entry->next->category <= cat) {
+        prev = entry->next;
+        entry->next = prev->next;
+    }
+
+    if (prev != NULL) prev->next = entry;
+    else if (head != NULL) HashTableReplace(&movie_index, minfo.mid, entry);
+    else if (HashTableInsert(&movie_index, minfo.mid, entry) != 0) {
+        free(entry);
+        return -1;
+    }
+
+    MemAccountAdd(&catalog_memory, 1, sizeof(struct catalog_entry));
+    return 0;
+}
+
+/* Deallocate entry, removed from movie_index. Nothing is done if it is NULL. */
+void CatalogEntryFree(struct catalog_entry* entry) {
+    if (entry == NULL) return;
+
+    MemAccountSub(&catalog_memory, 1, sizeof(struct catalog_entry));
+    free(entry);
+}
+
+/*
+ * Unlink from movie_index the first entry of mid in category list cat,
+ * or the first entry of mid if cat is -1.
+ * Returns the entry, NULL if there is none.
+*/
+struct catalog_entry* MovieIndexRemove(unsigned mid, int cat) {
+    struct catalog_entry* entry = (struct catalog_entry*) HashTableFind(&movie_index, mid);
+    struct catalog_entry* prev = NULL;
+
+    while (entry != NULL && cat != -1 && (int)entry->category != cat) {
+        prev = entry;
+        entry = entry->next;
+    }
+    if (entry == NULL) return NULL;
+
+    if (prev != NULL) prev->next = entry->next;
+    else if (entry->next != NULL) HashTableReplace(&movie_index, mid, entry->next);
+    else HashTableRemove(&movie_index, mid);
+
+    return entry;
+}
+
+/*
+ * Merge the m new movies (nmids, nyears), sorted by mid, into
+ * category list L, which must have room for them. Both are walked
+ * from the end, so every movie of L is moved at most once.
+ * Time complexity: O(n + m)
+*/
+void CategoryMerge(struct category_list* L, const unsigned* nmids, const unsigned* nyears, unsigned m) {
+    unsigned i = L->size;       /* Old movies left */
+    unsigned j = m;             /* New movies left */
+    unsigned k = L->size + m;   /* Next position to fill, from the end */
+
+    while (j > 0) {
+        --k;
+        if (i > 0 && L->mids[i - 1] > nmids[j - 1]) {
+            --i;
+            L->mids[k] = L->mids[i];
+            L->years[k] = L->years[i];
+        }
+        else {
+            --j;
+            L->mids[k] = nmids[j];
+            L->years[k] = nyears[j];
+        }
+    }
+
+    L->size += m;
+    MemAccountAdd(&category_memory, m, 0);
+}
+
+/*
+ * Split new_movies_list and merge it into the category array, so that
+ * every category list stays sorted by mid even if it already had movies.
+ * Every movie is also added to movie_index and the year index of its list.
+ * Time complexity: O(N + M), N the distributed movies, M the new ones
+*/
+void split_list(void) {
     struct new_movie* tmp = new_movies_list;
     struct new_movie* cur = NULL;   /* Used to deallocate new_movies_list*/
-    struct movie* SL_tails[6]; 	    /* Contains the tails of each category list */
+    unsigned counts[6];             /* New movies of each category */
+    unsigned start[6];              /* Where the new movies of each category go in nmids */
+    unsigned fill[6];
+    int reserved[6];                /* Whether category list i has room for its new movies */
+    unsigned* nmids = NULL;         /* The new movies, grouped by category */
+    unsigned* nyears = NULL;
+    unsigned total = 0;
+    struct category_list* L;
+    struct year_bucket* B;
 	int cat; 					    /* Movie Category*/
 	int i = 0;
+    unsigned j;
 
-	/* Initialize tails */
-    for (i = 0; i < 6; ++i) SL_tails[i] = NULL;
+    if (NewMoviesFlush() == -1) return;
+
+	/* Count the new movies of each category */
+    for (i = 0; i < 6; ++i) counts[i] = 0;
+    for (tmp = new_movies_list; tmp != NULL; tmp = tmp->next) counts[tmp->category]++;
+    for (i = 0; i < 6; ++i) {
+        start[i] = fill[i] = total;
+        total += counts[i];
+    }
 
+    nmids = (unsigned*) malloc((total + 1) * sizeof(unsigned));
+    nyears = (unsigned*) malloc((total + 1) * sizeof(unsigned));
+    if (nmids == NULL || nyears == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        free(nmids);
+        free(nyears);
+        return;
+    }
+
+    for (i = 0; i < 6; ++i) {
+        reserved[i] = (CategoryReserve(&category_array[i], category_array[i].size + counts[i]) == 0);
+    }
+
+    /* Slice new_movies_list by category, each slice stays sorted by mid */
+    tmp = new_movies_list;
     while (tmp != NULL) {
         cur = tmp;
         tmp = tmp->next;
 
         cat = cur->category;
+        nmids[fill[cat]] = cur->info.mid;
+        nyears[fill[cat]] = cur->info.year;
+        fill[cat]++;
+
+        if (reserved[cat]) MovieIndexInsert(cur->info, cur->category);
+
+        HashTableRemove(&new_movie_index, cur->info.mid);
+        PoolFree(&new_movie_pool, cur); /* Deallocate node from new_movies_list*/
+    }
+    new_movies_list = NULL;
+
+    for (i = 0; i < 6; ++i) {
+        L = &category_array[i];
+        if (counts[i] == 0 || !reserved[i]) continue;
 
         /* Add to the proper category table element*/
-        insert_end(&category_array[cat], &SL_tails[cat], cur->info.mid, cur->info.year);
+        CategoryMerge(L, &nmids[start[i]], &nyears[start[i]], counts[i]);
 
-        free(cur); /* Deallocate node from new_movies_list*/
+        /* Append to the year buckets, then merge each one with its older mids */
+        for (j = start[i]; j < fill[i]; ++j) {
+            B = YearBucketFind(L, nyears[j], 1);
+            if (B != NULL) YearBucketAppend(B, nmids[j]);
+        }
+        YearIndexMerge(L, &nmids[start[i]]); /* The slice is not needed any more */
     }
 
-    new_movies_list = NULL;
+    free(nmids);
+    free(nyears);
+}
+
+/*
+ * Binary search for mid in category list L. Sets pos to the position of
+ * mid, or to the position it should be inserted at if it is not inside.
+ * Returns 1 if mid was found, 0 otherwise.
+ * Time complexity: O(log n)
+*/
+int CategoryListFind(const struct category_list* L, unsigned mid, unsigned* pos) {
+    unsigned lo = 0;
+    unsigned hi = L->size;
+    unsigned m;
+
+    /* Invariant: mids[0..lo) < mid <= mids[hi..size) */
+    while (lo < hi) {
+        m = lo + (hi - lo) / 2;
+        if (L->mids[m] < mid) lo = m + 1;
+        else hi = m;
+    }
+
+    (*pos) = lo;
+    return (lo < L->size) && (L->mids[lo] == mid);
 }
 
 /*
- * Given the head of a category list, search for a movie with id mid.
+ * Given a category list, search for a movie with id mid.
  * Returns the movie_info of the movie found.
  * If there is no movie with id mid, retuns a
  * struct movie_info with mid = year = UINT_MAX.  
 */
-struct movie_info CategoryListSearch(struct movie* head, unsigned mid) {
-    struct movie* tmp = head;
-    struct movie_info errorinfo = {UINT_MAX, UINT_MAX}; /* error info */
+struct movie_info CategoryListSearch(const struct category_list* L, unsigned mid) {
+    struct movie_info minfo = {UINT_MAX, UINT_MAX}; /* error info */
+    unsigned pos;
 
-    /* 
-     * Scan the whole list. Category list is sorted so we
-     * don't need to scan movies with id larger than mid.
-    */
-    while (tmp != NULL && tmp->info.mid < mid) {
-        tmp = tmp->next;
+    if (CategoryListFind(L, mid, &pos)) {
+        minfo.mid = L->mids[pos];
+        minfo.year = L->years[pos];
     }
 
-    /* Here tmp is NULL or has tmp->info.mid >= mid */
-
-    if (tmp == NULL || tmp->info.mid != mid) {
-        return errorinfo;
-    }
-    else if (tmp->info.mid == mid){
-        return tmp->info; /* movie found */
-    }
+    return minfo;
 }
 
 /*
- * Scan every category list from the category table to find
- * the movie with the movie id mid.
+ * Find the movie with the movie id mid in the category table.
+ * Time complexity: O(1) on average, using movie_index.
  * 
  * Returns the movie_info of the movie with movie Id mid.
  * If there is no movie with the given mid, it returns 
  * a struct movie_info with mid = year = UINT_MAX.
 */
 struct movie_info CategoryArraySearch(unsigned mid) {
-    struct movie_info minfo; /* Movie info to return */ 
-    int i = 0;
-    for (i = 0; i < 6; ++i) {
-        minfo = CategoryListSearch(category_array[i], mid);
+    struct movie_info errorinfo = {UINT_MAX, UINT_MAX}; /* error info */
+    struct catalog_entry* entry = (struct catalog_entry*) HashTableFind(&movie_index, mid);
 
-        if (minfo.mid != UINT_MAX) break; /* Movie found */
-    }
-    return minfo;
+    return (entry != NULL) ? entry->info : errorinfo;
 }
 
-/* Deallocate all nodes of the category List given*/
-void CleanCategoryList(struct movie** L) {
-    struct movie* tmp = (*L);
-    struct movie* n = NULL;
-    while (tmp != NULL) {
-        n = tmp->next;
-        free(tmp);
-        tmp = n;
+/* Deallocate the category list given and the movie_index entries of its movies*/
+void CleanCategoryList(struct category_list* L) {
+    unsigned i = 0;
+
+    for (i = 0; i < L->size; ++i) {
+        CatalogEntryFree(MovieIndexRemove(L->mids[i], (int)(L - category_array)));
     }
 
-    (*L) = NULL;
+    for (i = 0; i < L->nbuckets; ++i) {
+        MemAccountSub(&year_index_memory, L->buckets[i].size, L->buckets[i].capacity * sizeof(unsigned));
+        free(L->buckets[i].mids);
+    }
+    MemAccountSub(&year_index_memory, 0, L->bucket_capacity * sizeof(struct year_bucket));
+    free(L->buckets);
+    L->buckets = NULL;
+    L->nbuckets = L->bucket_capacity = 0;
+
+    MemAccountSub(&category_memory, L->size, 2 * L->capacity * sizeof(unsigned));
+    free(L->mids);
+    free(L->years);
+    L->mids = L->years = NULL;
+    L->size = L->capacity = 0;
 }
 
 /*
@@ -343,7 +1162,7 @@ void CleanCategoryList(struct movie** L) {
 int IsEmptyWatchStack(struct movie* S) { return (S == NULL); }
 
 /*
- * Returns the movie_info of the top node of the watch stack.
+ * Returns the movie_info of the top of the watch stack.
  * If the stack is empty, returns a struct movie_info with mid = year = UINT_MAX.
 */
 struct movie_info Top(struct movie* S) {
@@ -353,30 +1172,36 @@ struct movie_info Top(struct movie* S) {
         return errorinfo;
     }
 
-    return S->info;
+    return S->info[S->count - 1];
 }
 
 /* 
- * Push a movie node with movie info minfo to watch stack.
+ * Push movie info minfo to watch stack. A new chunk is
+ * allocated only when the top one is full.
  * Returns 0 on success, otherwise -1.
 */ 
 int Push(struct movie** S, struct movie_info minfo) {
-    struct movie* new_film = (struct movie*) malloc(sizeof(struct movie));
-    
-    if (new_film == NULL) {
-        fprintf(stderr, "Malloc error\n");
-        return -1;
-    }
+    struct movie* chunk = (*S);
+
+    if (chunk == NULL || chunk->count == WATCH_CHUNK) {
+        chunk = (struct movie*) PoolAlloc(&movie_pool);
+        if (chunk == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            return -1;
+        }
 
-    new_film->info = minfo;
-    new_film->next = (*S);
+        chunk->count = 0;
+        chunk->next = (*S);
+        (*S) = chunk;
+    }
 
-    (*S) = new_film;
+    chunk->info[chunk->count++] = minfo;
     return 0;
 }
 
 /*
- * Returns the movie info of the top node and removes it from the watch stack.
+ * Returns the movie info of the top and removes it from the watch stack.
+ * The top chunk is deallocated once it is emptied.
  * If the stack is empty, returns a struct movie_info with mid = year = UINT_MAX.
 */
 struct movie_info Pop(struct movie** S) {
@@ -386,12 +1211,13 @@ struct movie_info Pop(struct movie** S) {
         return errorinfo;
     }
     
-    struct movie* tmp = (*S);           /* Node to delete. */
-    struct movie_info minfo = Top(*S);  /* Data to return. */
+    struct movie* tmp = (*S);                           /* Top chunk. */
+    struct movie_info minfo = tmp->info[--tmp->count];  /* Data to return. */
 
-    (*S) = (*S)->next;
-    
-    free(tmp);                          /* Deallocate node. */
+    if (tmp->count == 0) {
+        (*S) = tmp->next;
+        PoolFree(&movie_pool, tmp);     /* Deallocate emptied chunk. */
+    }
 
     return minfo;
 }
@@ -406,69 +1232,130 @@ struct movie_info Pop(struct movie** S) {
 void print_user_list() {
     struct user* tmp = user_list;
 
-    printf("Users = ");
+    OutputString("Users = ");
     
     while(tmp != guard) {
-        printf("<%d>", tmp->uid);
+        OutputChar('<');
+        OutputInt(tmp->uid);
+        OutputChar('>');
         tmp = tmp->next;
-        if (tmp != guard) printf(", ");
+        if (tmp != guard) OutputString(", ");
     }
 
-    putchar('\n');
+    OutputChar('\n');
 }
 
-/* Print New movies list*/
+/* Print New movies list, the staged movies are merged into it first*/
 void print_new_movie_list() {
-    struct new_movie* tmp = new_movies_list;
+    struct new_movie* tmp;
 	
-    printf("New movies = ");
+    NewMoviesFlush();
+    tmp = new_movies_list;
+
+    OutputString("New movies = ");
 
     while(tmp != NULL) {
-		printf("<%d, %d, %d>", tmp->info.mid, tmp->category, tmp->info.year);
+		OutputChar('<');
+		OutputInt(tmp->info.mid);
+		OutputString(", ");
+		OutputInt(tmp->category);
+		OutputString(", ");
+		OutputInt(tmp->info.year);
+		OutputChar('>');
 		tmp = tmp->next;
-        if (tmp != NULL) printf(", ");
+        if (tmp != NULL) OutputString(", ");
     }
     
-    putchar('\n');
+    OutputChar('\n');
 }
 
-/* Print a single category list with head given*/
-void print_category_list(struct movie* head) {
-    struct movie* tmp = head;
+/* Print the n movie ids given, as <mid>, <mid>, ... and a newline*/
+void print_mids(const unsigned* mids, unsigned n) {
+    unsigned i = 0;
     
-    while(tmp != NULL) {
-        printf("<%d>", tmp->info.mid);
-        tmp = tmp->next;
-        if (tmp != NULL) printf(", ");
+    for (i = 0; i < n; ++i) {
+        if (i > 0) OutputString(", ");
+        OutputChar('<');
+        OutputInt(mids[i]);
+        OutputChar('>');
     }
 
-    putchar('\n');
+    OutputChar('\n');
+}
+
+/* Print a single category list*/
+void print_category_list(const struct category_list* L) {
+    print_mids(L->mids, L->size);
 }
 
+/* Category names, as printed */
+static const char* cat_names[6] = {"Horror", "Sci-fi", "Drama",\
+                                   "Romance", "Documentary", "Comedy"};
+
 /* Print the whole category table*/
 void print_table() {
-    char* cat_names[6] = {"Horror", "Sci-fi", "Drama",\
-                          "Romance", "Documentary", "Comedy"};
 	int i = 0;
 	for (i = 0; i < 6; ++i) {
-		printf("  %s: ", cat_names[i]);
-		print_category_list(category_array[i]);
+		OutputString("  ");
+		OutputString(cat_names[i]);
+		OutputString(": ");
+		print_category_list(&category_array[i]);
 	}
 }
 
+/*
+ * Print the movies each category list is about to get from event D,
+ * skipping categories with none.
+*/
+void print_distributed() {
+    struct new_movie* tmp;
+    int first;
+    unsigned i = 0;
+
+    NewMoviesFlush();
+
+    OutputString("D\nCategorized Movies:\n");
+    for (i = 0; i < 6; ++i) {
+        first = 1;
+        for (tmp = new_movies_list; tmp != NULL; tmp = tmp->next) {
+            if (tmp->category != i) continue;
+
+            if (first) {
+                OutputString("  ");
+                OutputString(cat_names[i]);
+                OutputString(" += ");
+            }
+            else {
+                OutputString(", ");
+            }
+            OutputChar('<');
+            OutputInt(tmp->info.mid);
+            OutputChar('>');
+            first = 0;
+        }
+        if (!first) OutputChar('\n');
+    }
+}
+
 /* Print the watch stack given*/
 void print_watch_stack (struct movie* S) {
     struct movie* tmp = S;
+    unsigned i;
 
-    printf("Watch History = ");
+    OutputString("Watch History = ");
 
+    /* From the top: each chunk from its last movie to its first */
     while(tmp != NULL) {
-        printf("<%d>", tmp->info.mid);
+        for (i = tmp->count; i > 0; --i) {
+            if (tmp != S || i != tmp->count) OutputString(", ");
+            OutputChar('<');
+            OutputInt(tmp->info[i - 1].mid);
+            OutputChar('>');
+        }
         tmp = tmp->next;
-        if (tmp != NULL) printf(", ");
     }
     
-    putchar('\n');
+    OutputChar('\n');
 }
 
 /*
@@ -496,294 +1383,598 @@ int watch(int uid, unsigned mid) {
         return -1;
     }
 
-    /* Create a movie node and push it to user's watch stack*/
-    struct movie* new_film = (struct movie*) malloc(sizeof(struct movie));
-    Push(&(user_node->watchHistory), minfo);
-    return 0;
+    /* Push the movie to user's watch stack*/
+    return Push(&(user_node->watchHistory), minfo);
+}
+
+/*
+ ******************************************************************************
+ ******************************* SUGGEST **************************************
+ ******************************************************************************
+*/
+
+/*
+ * Add the movies event S picked for user u: right[0..nr) to the right
+ * of the head of the suggested list and left[0..nl) to the left of its
+ * tail, both in list order. This is where the two cursors of the event,
+ * one moving right from the head and one moving left from the tail,
+ * put them: after all the movies of right for an empty list, on both
+ * sides of the movie of a list of one.
+ * Returns 0 on success, -1 otherwise.
+*/
+int SuggestAround(struct user* u, const struct movie_info* right, unsigned nr,\
+                  const struct movie_info* left, unsigned nl) {
+    struct sugg_segment* head = u->suggestedHead;
+    struct sugg_segment* tail;
+
+    if (head == NULL) {                                     /* Empty list */
+        if (SuggestedInsert(u, NULL, 0, right, nr) == -1) return -1;
+        tail = u->suggestedTail;
+        return SuggestedInsert(u, tail, (tail != NULL) ? tail->count : 0, left, nl);
+    }
+
+    if ((head == u->suggestedTail) && (head->count == 1)) { /* A single movie */
+        if (SuggestedInsert(u, head, 0, left, nl) == -1) return -1;
+        tail = u->suggestedTail;
+        return SuggestedInsert(u, tail, tail->count, right, nr);
+    }
+
+    if (SuggestedInsert(u, head, 1, right, nr) == -1) return -1;
+    tail = u->suggestedTail;
+    return SuggestedInsert(u, tail, tail->count - 1, left, nl);
+}
+
+/* Print label and the suggested movies from position pos of segment seg to the end of its list*/
+void print_sug_from(const char* label, const struct sugg_segment* seg, unsigned pos) {
+    int first = 1;
+
+    OutputString(label);
+
+    for (; seg != NULL; seg = seg->next, pos = 0) {
+        for (; pos < seg->count; ++pos) {
+            if (!first) OutputString(", ");
+            OutputChar('<');
+            OutputInt(seg->info[pos].mid);
+            OutputChar('>');
+            first = 0;
+        }
+    }
+
+    OutputChar('\n');
+}
+
+void print_sug_list(const struct sugg_segment* head) {
+    print_sug_from("Suggested Movies = ", head, 0);
+}
+
+/*
+ * Print the result of a filtered search (events F and Q) of user uid,
+ * whose new suggestions start at position pos of segment added.
+*/
+void print_search_result(int uid, struct user* target_user, struct sugg_segment* added, unsigned pos) {
+    if (output_mode == OUTPUT_STATUS) return;
+
+    OutputString("   User <");
+    OutputInt(uid);
+    OutputString("> ");
+    if (output_mode == OUTPUT_FULL) print_sug_list(target_user->suggestedHead);
+    else print_sug_from("Suggested Movies += ", added, pos);
 }
 
 /*
  ******************************************************************************
- ******************************* SUGGEST **************************************
+ ****************************** FILTERING *************************************
  ******************************************************************************
 */
 
-/*
- * Insert a new node with info minfo to the right(next) of curr node.
- * Head and tail might need to change, so we pass them as index-to-index.
- * Also, it updates curr. Returns 1 on success, -1 otherwise.
- */
-int InsertRight(struct suggested_movie** curr, struct movie_info minfo,\
-                 struct suggested_movie** head, struct suggested_movie** tail) {
-    
-    /* Create suggested_movie node */
-    struct suggested_movie* new_sug_mov = (struct suggested_movie*)malloc(sizeof(struct suggested_movie));
-    if (new_sug_mov == NULL) {
-        fprintf(stderr, "Malloc error\n");
-        return -1;
-    }
-    new_sug_mov->info = minfo;
-    new_sug_mov->next = NULL;
-    new_sug_mov->prev = NULL;
+/* A run of movies sorted by mid, taking part in a k-way merge */
+struct merge_run {
+    const unsigned* mids;
+    const unsigned* years;  /* NULL if every movie of the run was released in year */
+    const unsigned* pos;    /* Positions of the movies in mids/years, NULL for all in order */
+    unsigned year;
+    unsigned n;             /* Number of movies */
+    unsigned next;          /* Next movie to merge */
+};
+
+/* Receives the movies of a k-way merge, in increasing mid order */
+typedef int (*merge_sink)(struct movie_info minfo, void* arg);
+
+/* Position of the next movie of run r in its columns */
+static unsigned MergeRunPos(const struct merge_run* r) {
+    return (r->pos != NULL) ? r->pos[r->next] : r->next;
+}
 
-    /* Initially Empty DLL */
-    if ((*curr) == NULL) {
-        (*head) = new_sug_mov;
-        (*curr) = new_sug_mov;
-        (*tail) = new_sug_mov;
-        return 1;
-    }
+static unsigned MergeRunMid(const struct merge_run* r) {
+    return r->mids[MergeRunPos(r)];
+}
 
-    /* curr's next before insertion of new node */
-    struct suggested_movie* q = (*curr)->next;
-    
-    new_sug_mov->prev = (*curr);
-    new_sug_mov->next = q;
+static unsigned MergeRunYear(const struct merge_run* r) {
+    return (r->years != NULL) ? r->years[MergeRunPos(r)] : r->year;
+}
 
-    (*curr)->next = new_sug_mov;
-    
-    if (q == NULL) (*tail) = new_sug_mov;
-    else q->prev = new_sug_mov;
+/*
+ * Restore the order of the merge heap below position i. heap[0..n) holds
+ * indices of runs, ordered by the mid of their next movie.
+*/
+static void SiftDown(unsigned* heap, unsigned n, unsigned i, const struct merge_run* runs) {
+    unsigned child;
+    unsigned top = heap[i];
+    unsigned top_mid = MergeRunMid(&runs[top]);
+
+    for (;;) {
+        child = 2 * i + 1;
+        if (child >= n) break;
+
+        /* Pick the smaller child */
+        if ((child + 1 < n) &&
+            (MergeRunMid(&runs[heap[child + 1]]) < MergeRunMid(&runs[heap[child]]))) {
+            child++;
+        }
 
-    (*curr) = new_sug_mov;  /* Move curr to the right */
+        if (MergeRunMid(&runs[heap[child]]) >= top_mid) break;
 
-    return 1;
+        heap[i] = heap[child];
+        i = child;
+    }
+
+    heap[i] = top;
 }
 
 /*
- * Insert a new node with info minfo to the left(prev) of curr node.
- * Head and tail might need to change, so we pass them as index-to-index.
- * Also, it updates curr. Returns 1 on success, -1 otherwise.
- */
-int InsertLeft(struct suggested_movie** curr, struct movie_info minfo,\
-                 struct suggested_movie** head, struct suggested_movie** tail) {
-    
-    /* Create suggested_movie node */
-    struct suggested_movie* new_sug_mov = (struct suggested_movie*)malloc(sizeof(struct suggested_movie));
-    if (new_sug_mov == NULL) {
+ * k-way merge of the sorted runs given with a binary heap. Every movie
+ * of the runs is passed, in increasing mid order, to sink.
+ * Returns 0 on success, -1 if sink or malloc failed.
+ * Time complexity: O(total * log k)
+*/
+int MergeRuns(struct merge_run* runs, unsigned k, merge_sink sink, void* arg) {
+    unsigned* heap;
+    unsigned n = 0;
+    unsigned i = 0;
+    struct merge_run* r;
+    struct movie_info minfo;
+
+    heap = (unsigned*) malloc((k + 1) * sizeof(unsigned));
+    if (heap == NULL) {
         fprintf(stderr, "Malloc error\n");
         return -1;
     }
-    new_sug_mov->info = minfo;
-
-    /* The second element of an initially empty list 
-       Here, head and tail point to te same node */
-    if ((*curr) == NULL) {
-        (*head)->next = new_sug_mov;
-        new_sug_mov->prev = (*head);
-        
-        new_sug_mov->next = NULL;
 
-        (*curr) = new_sug_mov;
-        (*tail) = new_sug_mov;
-        return 1;
+    /* Place the non empty runs in the heap and build it bottom up */
+    for (i = 0; i < k; ++i) {
+        if (runs[i].next < runs[i].n) heap[n++] = i;
     }
+    for (i = n / 2; i-- > 0;) SiftDown(heap, n, i, runs);
 
-    /* curr's prev before insertion of new node */
-    struct suggested_movie* q = (*curr)->prev;
-    
-    new_sug_mov->prev = q;
-    new_sug_mov->next = (*curr);
+    while (n > 0) {
+        r = &runs[heap[0]];
 
-    (*curr)->prev = new_sug_mov;
-    
-    if (q == NULL) (*head) = new_sug_mov;
-    else q->next = new_sug_mov;
+        minfo.mid = MergeRunMid(r);
+        minfo.year = MergeRunYear(r);
+        if (sink(minfo, arg) == -1) {
+            free(heap);
+            return -1;
+        }
 
-    (*curr) = new_sug_mov;  /* Move curr to the left */
+        /* Advance the run, drop it from the heap when it is over */
+        if (++r->next == r->n) heap[0] = heap[--n];
+        if (n > 0) SiftDown(heap, n, 0, runs);
+    }
 
-    return 1;
+    free(heap);
+    return 0;
 }
 
-/* 
- * Function for event S. Suggest movie to user uid 
- * based an the watch history of others.
- */
-int suggest(int uid) {
-    struct user* target_user;
-    struct user* tmp_user = user_list;
-    struct movie_info minfo;
-    int u_counter = 0;  /* count users whose pop was valid */
-    int check; /* Check the output of InsertRight and Left below*/
+/* Sink state storing the merged movies in an array */
+struct array_sink {
+    struct movie_info* out;
+    unsigned n;
+};
 
-    /* The new node will be added to the right(next) of this node*/
-    struct suggested_movie* to_right;
-
-    /* The new node will be added to the left(prev) of this node*/
-    struct suggested_movie* to_left;
+int ArraySink(struct movie_info minfo, void* arg) {
+    struct array_sink* a = (struct array_sink*) arg;
+    a->out[a->n++] = minfo;
+    return 0;
+}
 
-    /* Find target user */
-    target_user = FindUserList(uid);
-    if (target_user == NULL) {
-        fprintf(stderr, "User %d was not found\n", uid);
-        return -1;
-    }
+/*
+ * Decide how to find the movies of category list L with release year >= year.
+ * The year index is used when it holds less than a quarter of the list,
+ * then only those movies are visited. Otherwise the years column is
+ * scanned by the filter kernel.
+ * Returns 1 for the year index, 0 for the scan.
+*/
+int UseYearIndex(const struct category_list* L, unsigned year) {
+    unsigned b = YearIndexFirst(L, year);
+    unsigned q = 0; /* Movies with valid year */
 
-    to_right = target_user->suggestedHead;
-    to_left  = target_user->suggestedTail;
+    for (; (b < L->nbuckets) && (q < L->size / 4); ++b) q += L->buckets[b].size;
 
-    /*  Scan user_list */
-    while(tmp_user != guard) {
-        if (tmp_user->uid != uid) {
-            minfo = Pop(&tmp_user->watchHistory);
-            
-            /* This user has nothing on his watch history */
-            if (minfo.mid == UINT_MAX) {
-                tmp_user = tmp_user->next; /* go to next user */
-                continue; /* go back to the while-loop */
-            }
-            
-            /* Increase user counter */
-            u_counter++;
-            
-            /* Insert to the right */
-            if ((u_counter % 2 == 1)) {
-                check = InsertRight(&to_right, minfo, &target_user->suggestedHead, \
-                            &target_user->suggestedTail);
-                
-                if (check == -1) {
-                    fprintf(stderr, "Problem with InsertRight\n");   
-                    return -1;
-                }
-            }
-            else {
-                check = InsertLeft(&to_left, minfo, &target_user->suggestedHead,\
-                           &target_user->suggestedTail);
-                
-                if (check == -1) {
-                    fprintf(stderr, "Problem with InsertLeft\n");   
-                    return -1;
-                }
-            }
+    return (q < L->size / 4);
+}
 
-            tmp_user = tmp_user->next;
-        }
-        /* tmp_user is uid */
-        else {
-            tmp_user = tmp_user->next;
-            continue; /* go back to the while-loop */
+/*
+ * Add to runs the runs of category list L holding its movies
+ * with release year >= year: one run for each year of the year index,
+ * or a single run of the positions given by the filter kernel, which
+ * are stored in pos (room for L->size positions needed).
+ * Returns the number of runs added.
+*/
+unsigned CategoryRuns(const struct category_list* L, unsigned year, struct merge_run* runs,\
+                      unsigned* pos) {
+    unsigned b = 0;
+    unsigned k = 0;
+
+    if (UseYearIndex(L, year)) {
+        for (b = YearIndexFirst(L, year); b < L->nbuckets; ++b, ++k) {
+            runs[k].mids = L->buckets[b].mids;
+            runs[k].years = NULL;
+            runs[k].pos = NULL;
+            runs[k].year = L->buckets[b].year;
+            runs[k].n = L->buckets[b].size;
+            runs[k].next = 0;
         }
-    }    
+        return k;
+    }
 
-    return 0;
+    runs[0].mids = L->mids;
+    runs[0].years = L->years;
+    runs[0].pos = pos;
+    runs[0].year = 0;
+    runs[0].n = YearFilter(L->years, L->size, year, pos);
+    runs[0].next = 0;
+    return 1;
 }
 
-void print_sug_list(struct suggested_movie* head) {
-    struct suggested_movie* tmp = head;
-
-    printf("Suggested Movies = ");
+/* Max number of runs CategoryRuns may add for category list L */
+unsigned MaxCategoryRuns(const struct category_list* L) {
+    return (L->nbuckets > 0) ? L->nbuckets : 1;
+}
 
-    while (tmp != NULL) {
-        printf("<%d>", tmp->info.mid);
-        tmp = tmp->next;
-        if (tmp != NULL) printf(", ");
+/*
+ * Store in out, sorted by mid, the movies of category list L
+ * with release year >= year. out needs room for L->size movies.
+ * Returns the number of movies stored, or -1 on malloc error.
+*/
+long SelectByYear(const struct category_list* L, unsigned year, struct movie_info* out) {
+    struct merge_run* runs;
+    unsigned* pos;
+    struct array_sink sink;
+    unsigned k;
+    int code;
+
+    runs = (struct merge_run*) malloc(MaxCategoryRuns(L) * sizeof(struct merge_run));
+    pos = (unsigned*) malloc((L->size + 1) * sizeof(unsigned));
+    if (runs == NULL || pos == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        free(runs);
+        free(pos);
+        return -1;
     }
 
-    putchar('\n');
+    k = CategoryRuns(L, year, runs, pos);
+
+    sink.out = out;
+    sink.n = 0;
+    code = MergeRuns(runs, k, ArraySink, &sink);
+
+    free(runs);
+    free(pos);
+    return (code == 0) ? (long)sink.n : -1;
 }
 
 /*
  ******************************************************************************
- ****************************** FILTERING *************************************
+ *************************** TAKE OFF MOVIE ***********************************
  ******************************************************************************
 */
 
+/* A movie of a take-off batch, marked in the category table but not yet removed */
+struct removal {
+    int category;
+    unsigned pos;       /* Position in its category list */
+    unsigned mid;
+    unsigned year;
+};
+
+/* Order removals by year, then mid */
+int CompareRemovals(const void* a, const void* b) {
+    const struct removal* x = (const struct removal*) a;
+    const struct removal* y = (const struct removal*) b;
+
+    if (x->year != y->year) return (x->year > y->year) ? 1 : -1;
+    return (x->mid > y->mid) - (x->mid < y->mid);
+}
+
+/* Print category list L without the n movies of skip, sorted by position */
+void print_category_list_except(const struct category_list* L, const struct removal* skip, unsigned n) {
+    unsigned i, s = 0;
+    int first = 1;
+
+    for (i = 0; i < L->size; ++i) {
+        if (s < n && skip[s].pos == i) {
+            s++;
+            continue;
+        }
+        if (!first) OutputString(", ");
+        OutputChar('<');
+        OutputInt(L->mids[i]);
+        OutputChar('>');
+        first = 0;
+    }
+
+    OutputChar('\n');
+}
+
 /*
- * Insert to the tail of a doubly linked list a node with movie info minfo.
- * Returns 0 on success, -1 otherwise.
+ * Mark movie mid of the category table for removal, adding it to
+ * removals[0..n), which is kept sorted by category and position.
+ * The movie stays in its category list until RemoveFromTable(), so the
+ * positions already marked stay valid, but it is left out of the printed list.
+ * Only the category list given by the movie_index entry of mid is searched.
+ * Returns the new number of marked movies.
 */
-int InsertDLLTail(struct movie_info minfo, struct suggested_movie** head,\
-                    struct suggested_movie** tail) {
-    struct suggested_movie* new_node = (struct suggested_movie*)malloc(sizeof(struct suggested_movie));
-    if (new_node == NULL) {
-        fprintf(stderr, "Malloc Error\n");
-        return -1;
+unsigned MarkInTable(unsigned mid, struct removal* removals, unsigned n) {
+    struct catalog_entry* entry = MovieIndexRemove(mid, -1);
+    struct category_list* L;
+    unsigned pos, year, i, first, last;
+    int cat;
+
+    if (entry == NULL) return n; /* mid is not in the table */
+
+    cat = entry->category;
+    year = entry->info.year;
+    L = &category_array[cat];
+    CatalogEntryFree(entry);
+
+    if (!CategoryListFind(L, mid, &pos)) {
+        YearIndexRemove(L, mid, year);
+        return n;
     }
-    new_node->info = minfo;
-    
-    new_node->next = NULL;
-    new_node->prev = (*tail);
 
-    if (((*head) == NULL) && ((*tail) == NULL)) {   /* Empty list */
-        (*head) = new_node;
-    }
-    else {                                          /* Not empty list */
-        (*tail)->next = new_node;
+    /* Copies of mid in L already marked take the positions from pos on */
+    for (i = 0; i < n; ++i) {
+        if (removals[i].category == cat && removals[i].mid == mid) pos++;
     }
 
-    (*tail) = new_node;
+    /* Insert in (category, position) order */
+    for (i = n; i > 0 && (removals[i - 1].category > cat ||
+         (removals[i - 1].category == cat && removals[i - 1].pos > pos)); --i) {
+        removals[i] = removals[i - 1];
+    }
+    removals[i].category = cat;
+    removals[i].pos = pos;
+    removals[i].mid = mid;
+    removals[i].year = year;
+    n++;
+
+    if (output_mode == OUTPUT_FULL) {
+        for (first = i; first > 0 && removals[first - 1].category == cat; --first);
+        for (last = i + 1; last < n && removals[last].category == cat; ++last);
+
+        OutputString("  Category list = ");
+        print_category_list_except(L, &removals[first], last - first);
+    }
+    else if (output_mode == OUTPUT_DELTA) {
+        OutputString("  Category list -= <");
+        OutputInt(mid);
+        OutputString(">\n");
+    }
 
-    return 0;
+    return n;
 }
 
 /*
- ******************************************************************************
- *************************** TAKE OFF MOVIE ***********************************
- ******************************************************************************
+ * Remove the n marked movies of category list L from its year index,
+ * with one pass over each bucket that holds some of them.
+ * removals is reordered.
 */
+void YearIndexRemoveAll(struct category_list* L, struct removal* removals, unsigned n) {
+    struct year_bucket* B;
+    unsigned i, j, s, m, w;
 
-/* Remove movie from category table*/
-void RemoveFromTable(unsigned mid) {
-    struct movie* cat_list_tmp = NULL;
-    struct movie* cat_list_prev = NULL;
-    int i = 0;
-    for (i = 0; i < 6; ++i) {
-        cat_list_tmp = category_array[i];
-        
-        /* Scan the category list*/
-        while ((cat_list_tmp != NULL) && (cat_list_tmp->info.mid < mid)) {
-            cat_list_prev = cat_list_tmp;
-            cat_list_tmp = cat_list_tmp->next;
-        }
+    qsort(removals, n, sizeof(struct removal), CompareRemovals);
 
-        /* mid found */
-        if ((cat_list_tmp != NULL) && (cat_list_tmp->info.mid == mid)) {
-            /* mid is the head node */
-            if (cat_list_tmp == category_array[i]) {
-                category_array[i] = cat_list_tmp->next; /* Update list head*/
+    for (i = 0; i < n; i = j) {
+        /* removals[i..j) are of the same year, sorted by mid as the bucket is */
+        for (j = i + 1; j < n && removals[j].year == removals[i].year; ++j);
+
+        B = YearBucketFind(L, removals[i].year, 0);
+        if (B == NULL) continue;
+
+        s = i;
+        for (m = w = 0; m < B->size; ++m) {
+            while (s < j && removals[s].mid < B->mids[m]) s++;
+            if (s < j && removals[s].mid == B->mids[m]) {
+                s++;    /* One copy for each removal */
+                continue;
             }
-            /* mid is a regular node*/
-            else cat_list_prev->next = cat_list_tmp->next;
+            B->mids[w++] = B->mids[m];
+        }
+        MemAccountSub(&year_index_memory, B->size - w, 0);
+        B->sorted -= B->size - w;
+        B->size = w;
+    }
 
-            free (cat_list_tmp);
-            printf("  Category list = ");
-            print_category_list(category_array[i]);
-            break; /* for loop*/
+    /* Drop the buckets left empty */
+    for (i = w = 0; i < L->nbuckets; ++i) {
+        if (L->buckets[i].size == 0) {
+            MemAccountSub(&year_index_memory, 0, L->buckets[i].capacity * sizeof(unsigned));
+            free(L->buckets[i].mids);
         }
+        else L->buckets[w++] = L->buckets[i];
     }
+    L->nbuckets = w;
 }
 
 /*
- * Remove movie with mid from suggested list DLL described by head and tail.
- * Returns 0 on success, -1 otherwise.
+ * Remove the n movies marked by MarkInTable() from the category table
+ * and the year indexes, with one pass over each category list touched.
+ * Time complexity: O(size of the touched lists and buckets + n log n)
+*/
+void RemoveFromTable(struct removal* removals, unsigned n) {
+    struct category_list* L;
+    unsigned i, j, r, w, end;
+
+    for (i = 0; i < n; i = j) {
+        L = &category_array[removals[i].category];
+        for (j = i + 1; j < n && removals[j].category == removals[i].category; ++j);
+
+        /* Move the movies between two marked positions left, a run at a time */
+        w = removals[i].pos;
+        for (r = i; r < j; ++r) {
+            end = (r + 1 < j) ? removals[r + 1].pos : L->size;
+            memmove(&L->mids[w], &L->mids[removals[r].pos + 1], (end - removals[r].pos - 1) * sizeof(unsigned));
+            memmove(&L->years[w], &L->years[removals[r].pos + 1], (end - removals[r].pos - 1) * sizeof(unsigned));
+            w += end - removals[r].pos - 1;
+        }
+        MemAccountSub(&category_memory, L->size - w, 0);
+        L->size = w;
+
+        YearIndexRemoveAll(L, &removals[i], j - i);
+    }
+}
+
+/* Order suggested movie nodes as their owners appear in user_list. */
+int CompareOwners(const void* a, const void* b) {
+    const struct user* x = (*(struct suggested_movie* const*)a)->segment->owner;
+    const struct user* y = (*(struct suggested_movie* const*)b)->segment->owner;
+
+    if (x->order == y->order) return 0;
+    return (x->order > y->order) ? -1 : 1; /* Newer users come first */
+}
+
+/*
+ * Remove the first occurrence of mid from every suggested list that holds it
+ * and print the users affected in user_list order. Only the nodes chained in
+ * suggestion_index are visited, not every suggested list.
+ * Time complexity: O(k log k), where k is the number of nodes with mid.
+ * The first copy of an owner that holds mid more than once is the one
+ * whose segment has the lowest seq, and position in it.
 */
-int RemoveFromSuggList(unsigned mid, struct suggested_movie** head,\
-                       struct suggested_movie** tail) {
-    struct suggested_movie* tmp = (*head);
+void RemoveFromSuggLists(unsigned mid) {
+    struct suggested_movie* tmp;
+    struct suggested_movie** nodes;  /* Nodes with mid, grouped by owner */
+    struct user* owner;
+    size_t count = 0;
+    size_t i = 0, j = 0, k;
 
-    /* Search for mid*/
-    while (tmp != NULL && (tmp->info.mid != mid)) tmp = tmp->next;
+    tmp = (struct suggested_movie*) HashTableFind(&suggestion_index, mid);
+    if (tmp == NULL) return; /* No list holds mid */
 
-    if (tmp == NULL) return -1; /* mid not found*/
+    for (; tmp != NULL; tmp = tmp->ref_next) count++;
 
-    if ((tmp == (*head)) && (tmp == (*tail))) { /* mid is the only node */
-        (*head) = (*tail) = NULL;               /* Update head and tail*/
+    nodes = (struct suggested_movie**) malloc(count * sizeof(struct suggested_movie*));
+    if (nodes == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return;
     }
-    else if (tmp == (*head)) {                  /* mid is the head */
-        (*head) = tmp->next;                    /* Update head */
-        (*head)->prev = NULL;
+
+    tmp = (struct suggested_movie*) HashTableFind(&suggestion_index, mid);
+    for (i = 0; tmp != NULL; tmp = tmp->ref_next) nodes[i++] = tmp;
+
+    qsort(nodes, count, sizeof(struct suggested_movie*), CompareOwners);
+
+    for (i = 0; i < count; i = j) {
+        owner = nodes[i]->segment->owner;
+
+        /* nodes[i..j) belong to owner */
+        for (j = i + 1; (j < count) && (nodes[j]->segment->owner == owner); ++j);
+
+        /* Only the first occurrence in the list is removed */
+        for (k = i + 1; k < j; ++k) {
+            if (SuggBefore(nodes[k], nodes[i])) nodes[i] = nodes[k];
+        }
+
+        /* Only nodes of owner move, the other groups stay valid */
+        SuggestedErase(nodes[i], mid);
+        if (output_mode != OUTPUT_STATUS) {
+            OutputString("   <");
+            OutputInt(mid);
+            OutputString("> removed from <");
+            OutputInt(owner->uid);
+            OutputString("> suggested list.\n");
+        }
     }
-    else if (tmp == (*tail)) {                  /* mid is the tail*/
-        (*tail) = tmp->prev;                    /* Update tail */
-        (*tail)->next = NULL;
+
+    free(nodes);
+}
+
+/*
+ ******************************************************************************
+ ***************************** MEMORY REPORT **********************************
+ ******************************************************************************
+*/
+
+/* Memory of the objects of pool P in use, as an account */
+void PoolAccount(const struct pool* P, struct mem_account* A) {
+    A->nodes = P->live;
+    A->peak_nodes = P->peak;
+    A->bytes = P->live * (unsigned long)P->obj_size;
+    A->peak_bytes = P->peak * (unsigned long)P->obj_size;
+}
+
+/* Memory of the slots of hash table T, as an account. Tables never shrink. */
+void HashTableAccount(const struct hash_table* T, struct mem_account* A) {
+    A->nodes = T->size;
+    A->peak_nodes = T->peak;
+    A->bytes = A->peak_bytes = T->capacity * (unsigned long)sizeof(struct hash_slot);
+}
+
+/*
+ * Pass the lines of the memory report to put, one at a time: nodes and
+ * bytes of every structure, now and at their peak, then the bytes
+ * allocated in all. Pool objects are counted in the slabs of their pool.
+*/
+void MemoryReport(void (*put)(const char*)) {
+    const struct pool* pools[4];
+    const char* pool_names[4] = {"users", "watch stacks", "suggested lists", "new movies"};
+    const struct hash_table* tables[4];
+    const char* table_names[4] = {"user index", "movie index", "new movie index", "suggestion index"};
+    struct mem_account A;
+    unsigned long total = 0;
+    char line[MEM_ACCOUNT_LINE];
+    int i;
+
+    pools[0] = &user_pool;
+    pools[1] = &movie_pool;
+    pools[2] = &suggested_pool;
+    pools[3] = &new_movie_pool;
+    tables[0] = &user_index;
+    tables[1] = &movie_index;
+    tables[2] = &new_movie_index;
+    tables[3] = &suggestion_index;
+
+    sprintf(line, "  %-17s %10s %10s %12s %12s\n", "structure", "nodes", "peak", "bytes", "peak bytes");
+    put(line);
+
+    for (i = 0; i < 4; ++i) {
+        PoolAccount(pools[i], &A);
+        MemAccountFormat(&A, pool_names[i], line);
+        put(line);
+        total += pools[i]->capacity * (unsigned long)pools[i]->obj_size;
     }
-    else {                                      /* mid is a regular node*/
-        (tmp->prev)->next = tmp->next;
-        (tmp->next)->prev = tmp->prev;
+
+    MemAccountFormat(&category_memory, "category lists", line);
+    put(line);
+    MemAccountFormat(&year_index_memory, "year index", line);
+    put(line);
+    MemAccountFormat(&catalog_memory, "catalog entries", line);
+    put(line);
+    MemAccountFormat(&mid_set_memory, "suggested sets", line);
+    put(line);
+    total += category_memory.bytes + year_index_memory.bytes + catalog_memory.bytes;
+    total += mid_set_memory.bytes;
+
+    for (i = 0; i < 4; ++i) {
+        HashTableAccount(tables[i], &A);
+        MemAccountFormat(&A, table_names[i], line);
+        put(line);
+        total += A.bytes;
     }
 
-    free(tmp);
-    return 0;
+    sprintf(line, "  total allocated %lu bytes\n", total);
+    put(line);
 }
 
 /*
@@ -807,9 +1998,19 @@ int RemoveFromSuggList(unsigned mid, struct suggested_movie** head,\
 int register_user(int uid) {
     int code = UserListInsert(uid);
     
-    printf("R <%d>\n  ", uid);
-    print_user_list();
-    printf("DONE\n");
+    OutputString("R <");
+    OutputInt(uid);
+    OutputString(">\n");
+    if (output_mode == OUTPUT_FULL) {
+        OutputString("  ");
+        print_user_list();
+    }
+    else if (output_mode == OUTPUT_DELTA && code == 0) {
+        OutputString("  Users += <");
+        OutputInt(uid);
+        OutputString(">\n");
+    }
+    OutputString("DONE\n");
 
     return code;
 }
@@ -823,12 +2024,23 @@ int register_user(int uid) {
  * user's suggested movie list and
  * watch history stack
  */
-void unregister_user(int uid) {
-    DeleteUser(uid);
-
-    printf("U <%d>\n  ", uid);
-    print_user_list();
-    printf("DONE\n");
+int unregister_user(int uid) {
+    int code = DeleteUser(uid);
+
+    OutputString("U <");
+    OutputInt(uid);
+    OutputString(">\n");
+    if (output_mode == OUTPUT_FULL) {
+        OutputString("  ");
+        print_user_list();
+    }
+    else if (output_mode == OUTPUT_DELTA && code == 0) {
+        OutputString("  Users -= <");
+        OutputInt(uid);
+        OutputString(">\n");
+    }
+    OutputString("DONE\n");
+    return code;
 }
 
 /*
@@ -844,12 +2056,30 @@ void unregister_user(int uid) {
  * Returns 0 on success, -1 on failure
  */
 int add_new_movie(unsigned mid, movieCategory_t category, unsigned year) {
-    int code = NewMoviesInsertSorted(mid, category, year);
+    int code = NewMoviesStage(mid, category, year);
     
     if (code == 0) {
-        printf("A <%d> <%d> <%d>\n  ", mid, category, year);
-        print_new_movie_list();
-        printf("DONE\n");
+        OutputString("A <");
+        OutputInt(mid);
+        OutputString("> <");
+        OutputInt(category);
+        OutputString("> <");
+        OutputInt(year);
+        OutputString(">\n");
+        if (output_mode == OUTPUT_FULL) {
+            OutputString("  ");
+            print_new_movie_list();
+        }
+        else if (output_mode == OUTPUT_DELTA) {
+            OutputString("  New movies += <");
+            OutputInt(mid);
+            OutputString(", ");
+            OutputInt(category);
+            OutputString(", ");
+            OutputInt(year);
+            OutputString(">\n");
+        }
+        OutputString("DONE\n");
     }
 
     return code;
@@ -867,11 +2097,17 @@ int add_new_movie(unsigned mid, movieCategory_t category, unsigned year) {
  * of the new movies list
  */
 void distribute_new_movies(void) {
+    if (output_mode == OUTPUT_DELTA) print_distributed();
     split_list();
 
-    printf("D\nCategorized Movies:\n");
-    print_table();
-    printf("DONE\n");
+    if (output_mode == OUTPUT_FULL) {
+        OutputString("D\nCategorized Movies:\n");
+        print_table();
+    }
+    else if (output_mode == OUTPUT_STATUS) {
+        OutputString("D\n");
+    }
+    OutputString("DONE\n");
 }
 
 /*
@@ -903,14 +2139,28 @@ int watch_movie(int uid, unsigned mid) {
         return -1;
     }
 
-    /* Create a movie node and push it to user's watch stack*/
-    struct movie* new_film = (struct movie*) malloc(sizeof(struct movie));
-    Push(&(user_node->watchHistory), minfo);
-
-    printf("W <%d>, <%d>\n  ", uid, mid);
-    printf("User <%d> ", uid);
-    print_watch_stack(user_node->watchHistory);
-    printf("DONE\n");
+    /* Push the movie to user's watch stack*/
+    if (Push(&(user_node->watchHistory), minfo) == -1) return -1;
+
+    OutputString("W <");
+    OutputInt(uid);
+    OutputString(">, <");
+    OutputInt(mid);
+    OutputString(">\n");
+    if (output_mode == OUTPUT_FULL) {
+        OutputString("  User <");
+        OutputInt(uid);
+        OutputString("> ");
+        print_watch_stack(user_node->watchHistory);
+    }
+    else if (output_mode == OUTPUT_DELTA) {
+        OutputString("  User <");
+        OutputInt(uid);
+        OutputString("> Watch History += <");
+        OutputInt(mid);
+        OutputString(">\n");
+    }
+    OutputString("DONE\n");
 
     return 0;
 }
@@ -937,13 +2187,18 @@ int suggest_movies(int uid) {
     struct user* tmp_user = user_list;
     struct movie_info minfo;
     int u_counter = 0;  /* count users whose pop was valid */
-    int check; /* Check the output of InsertRight and Left below*/
+    unsigned* added = NULL; /* Suggested mids, in the order they were added */
 
-    /* The new node will be added to the right(next) of this node*/
-    struct suggested_movie* to_right;
+    /*
+     * Movies for the right of the head, from the front, and for the left
+     * of the tail, from the back, so both runs are in list order.
+    */
+    struct movie_info* picked;
+    unsigned cap = user_index.size + 1;
+    unsigned nr = 0, nl = 0;
 
-    /* The new node will be added to the left(prev) of this node*/
-    struct suggested_movie* to_left;
+    /* Movies picked, when the list takes no movie twice */
+    struct mid_set seen;
 
     /* Find target user */
     target_user = FindUserList(uid);
@@ -952,42 +2207,48 @@ int suggest_movies(int uid) {
         return -1;
     }
 
-    to_right = target_user->suggestedHead;
-    to_left  = target_user->suggestedTail;
+    picked = (struct movie_info*) malloc(cap * sizeof(struct movie_info));
+    if (picked == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        return -1;
+    }
+
+    /* In delta output only the new suggestions are printed, keep them */
+    if (output_mode == OUTPUT_DELTA) {
+        added = (unsigned*) malloc(cap * sizeof(unsigned));
+        if (added == NULL) {
+            fprintf(stderr, "Malloc error\n");
+            free(picked);
+            return -1;
+        }
+    }
+
+    MidSetInit(&seen);
+    if (dedupe_suggestions && MidSetReserve(&seen, cap) == -1) {
+        free(picked);
+        free(added);
+        return -1;
+    }
 
     /*  Scan user_list */
     while(tmp_user != guard) {
         if (tmp_user->uid != uid) {
             minfo = Pop(&tmp_user->watchHistory);
             
-            /* This user has nothing on his watch history */
-            if (minfo.mid == UINT_MAX) {
+            /* This user has nothing on his watch history, or nothing new */
+            if ((minfo.mid == UINT_MAX) ||
+                (dedupe_suggestions && !SuggestedIsNew(target_user, &seen, minfo.mid))) {
                 tmp_user = tmp_user->next; /* go to next user */
                 continue; /* go back to the while-loop */
             }
             
             /* Increase user counter */
+            if (added != NULL) added[u_counter] = minfo.mid;
             u_counter++;
             
-            /* Insert to the right */
-            if ((u_counter % 2 == 1)) {
-                check = InsertRight(&to_right, minfo, &target_user->suggestedHead, \
-                            &target_user->suggestedTail);
-                
-                if (check == -1) {
-                    fprintf(stderr, "Problem with InsertRight\n");   
-                    return -1;
-                }
-            }
-            else {
-                check = InsertLeft(&to_left, minfo, &target_user->suggestedHead,\
-                           &target_user->suggestedTail);
-                
-                if (check == -1) {
-                    fprintf(stderr, "Problem with InsertLeft\n");   
-                    return -1;
-                }
-            }
+            /* To the right, then to the left */
+            if ((u_counter % 2 == 1)) picked[nr++] = minfo;
+            else picked[cap - ++nl] = minfo;
 
             tmp_user = tmp_user->next;
         }
@@ -998,10 +2259,34 @@ int suggest_movies(int uid) {
         }
     }    
 
-    printf("S <%d>\n  ", uid);
-    printf("User <%d> ", uid);
-    print_sug_list(target_user->suggestedHead);
-    printf("DONE\n");
+    MidSetDestroy(&seen);
+
+    if (SuggestAround(target_user, picked, nr, picked + cap - nl, nl) == -1) {
+        fprintf(stderr, "Problem with SuggestAround\n");
+        free(picked);
+        free(added);
+        return -1;
+    }
+    free(picked);
+
+    OutputString("S <");
+    OutputInt(uid);
+    OutputString(">\n");
+    if (output_mode == OUTPUT_FULL) {
+        OutputString("  User <");
+        OutputInt(uid);
+        OutputString("> ");
+        print_sug_list(target_user->suggestedHead);
+    }
+    else if (output_mode == OUTPUT_DELTA) {
+        OutputString("  User <");
+        OutputInt(uid);
+        OutputString("> Suggested Movies += ");
+        print_mids(added, u_counter);
+    }
+    OutputString("DONE\n");
+
+    free(added);
 
     return 0;
 }
@@ -1024,16 +2309,21 @@ int filtered_movie_search(int uid, movieCategory_t category1,
 		movieCategory_t category2, unsigned year) {
     struct user* target_user;
 
-    /* Pointers to the head of each category list*/
-    struct movie* cat1 = category_array[category1];
-    struct movie* cat2 = category_array[category2];
-    
-    /* Pointers for the DLL we will create*/
-    struct suggested_movie* new_head = NULL;
-    struct suggested_movie* new_tail = NULL;
+    /* The two category lists */
+    const struct category_list* L1 = &category_array[category1];
+    const struct category_list* L2 = &category_array[category2];
 
-    /* Check the exit code of InsertDLLTail()*/
-    int code = 0;
+    /* Movies with valid year of each list and our place in them*/
+    struct movie_info* sel1;
+    struct movie_info* sel2;
+    long n1 = -1, n2 = -1;
+    long k1 = 0, k2 = 0;
+    
+    /* The movies to append, and the place of the first one once appended */
+    struct movie_info* found;
+    unsigned n = 0;
+    struct sugg_segment* added;
+    unsigned added_pos;
     
     /* Find the user with id uid*/
     target_user = FindUserList(uid);
@@ -1041,82 +2331,155 @@ int filtered_movie_search(int uid, movieCategory_t category1,
         fprintf(stderr, "User %d does not exist.\n", uid);
         return -1;
     }
-    
-    while ((cat1 != NULL) && (cat2 != NULL)) {
-        /* Check if years are valid*/
-        if (cat1->info.year < year) {
-            cat1 = cat1->next;
-            continue;
-        }
-        if (cat2->info.year < year) {
-            cat2 = cat2->next;
-            continue;
-        }
 
-        /* Here both cat1 and cat2 point to movies with valid year*/
-
-        if (cat1->info.mid < cat2->info.mid) { /* mid_1 < mid_2 */
-            /* Add to the tail of new DLL */
-            code = InsertDLLTail(cat1->info, &new_head, &new_tail);
-            if (code == -1) return code;
-            
-            cat1 = cat1->next;
+    sel1 = (struct movie_info*) malloc((L1->size + 1) * sizeof(struct movie_info));
+    sel2 = (struct movie_info*) malloc((L2->size + 1) * sizeof(struct movie_info));
+    found = (struct movie_info*) malloc((L1->size + L2->size + 1) * sizeof(struct movie_info));
+    if (sel1 != NULL && sel2 != NULL && found != NULL) {
+        n1 = SelectByYear(L1, year, sel1);
+        n2 = SelectByYear(L2, year, sel2);
+    }
+    if (n1 == -1 || n2 == -1) {
+        fprintf(stderr, "Malloc error\n");
+        free(sel1);
+        free(sel2);
+        free(found);
+        return -1;
+    }
+    
+    /* Merge the two filtered lists, on equal mids the second one goes first*/
+    while ((k1 < n1) && (k2 < n2)) {
+        if (sel1[k1].mid < sel2[k2].mid) { /* mid_1 < mid_2 */
+            found[n++] = sel1[k1++];
         }
         else { /*mid_2 < mid_1*/
-            /* Add to the tail of new DLL */
-            code = InsertDLLTail(cat2->info, &new_head, &new_tail);
-            if (code == -1) return code;
-
-            cat2 = cat2->next;
+            found[n++] = sel2[k2++];
         }
     }
     /* 
-     * Here one of the cat pointers points to NULL.
-     * This is the cat pointer of the list whose 
-     * max(mid value) < max(mid value) of the other list .
+     * Here one of the filtered lists has been exhausted. As the
+     * event always did, the remaining movies of the other one
+     * are added only if released strictly after year.
     */
+    for (; k1 < n1; ++k1) {
+        if (sel1[k1].year > year) found[n++] = sel1[k1];
+    }
+    for (; k2 < n2; ++k2) {
+        if (sel2[k2].year > year) found[n++] = sel2[k2];
+    }
 
-    if (cat1 == NULL) {
-        /* Insert the remaining movies with valid year from cat2 */
-        while(cat2 != NULL) {
-            if (cat2->info.year > year) {
-                code = InsertDLLTail(cat2->info, &new_head, &new_tail);
-                if (code == -1) return code;
-            }
-            cat2 = cat2->next;
-        }
+    free(sel1);
+    free(sel2);
+
+    /* Append them to the suggested list of the user*/
+    if ((dedupe_suggestions && SuggestedDedupe(target_user, found, &n) == -1) ||
+        (AppendSuggested(target_user, found, n, &added, &added_pos) == -1)) {
+        free(found);
+        return -1;
     }
-    else { /*cat2 == NULL*/
-        /* Insert the remaining movies with valid year from cat1 */
-        while(cat1 != NULL) {
-            if (cat1->info.year > year) {
-                code = InsertDLLTail(cat1->info, &new_head, &new_tail);
-                if (code == -1) return code;
-            }
-            cat1 = cat1->next;
-        }
+    free(found);
+
+    OutputString("F <");
+    OutputInt(uid);
+    OutputString("> <");
+    OutputInt(category1);
+    OutputString("> <");
+    OutputInt(category2);
+    OutputString("> <");
+    OutputInt(year);
+    OutputString(">\n");
+    print_search_result(uid, target_user, added, added_pos);
+    OutputString("DONE\n");
+    return 0;
+}
+
+/*
+ * Multi-category filtered search - Event Q
+ *
+ * User uid asks to be suggested movies belonging
+ * to any category c with bit (1 << c) set in
+ * category_mask and with release year >= year.
+ * The movies are appended to the suggested list
+ * in increasing order based on movie ID, with a
+ * k-way merge of the selected category lists.
+ * Time complexity: O(total * log k)
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int filtered_multi_search(int uid, unsigned category_mask, unsigned year) {
+    struct user* target_user;
+    struct merge_run* runs;
+    unsigned k = 0;     /* Number of runs */
+    unsigned* pos;      /* Positions given by the filter kernel, for all lists */
+    unsigned max_runs = 0;
+    unsigned total = 0;
+    int code = 0;
+    int i = 0;
+
+    /* The movies to append, and the place of the first one once appended */
+    struct array_sink sink;
+    struct sugg_segment* added;
+    unsigned added_pos;
+
+    if (category_mask >> 6 != 0) {
+        fprintf(stderr, "Invalid category mask %u\n", category_mask);
+        return -1;
     }
-    /* Connect new DLL to the suggested DLL of the user*/
 
-    /* Suggested list was empty*/
-    if ((target_user->suggestedHead == NULL) && (target_user->suggestedTail == NULL)) {
-        /* The suggested DLL is the same as the new DLL*/
-        target_user->suggestedHead = new_head;
-        target_user->suggestedTail = new_tail;
+    /* Find the user with id uid*/
+    target_user = FindUserList(uid);
+    if (target_user == NULL) {
+        fprintf(stderr, "User %d does not exist.\n", uid);
+        return -1;
     }
-    else {
-        /* Connect the tail of existing suggested DLL to the head of the new one*/
-        target_user->suggestedTail->next = new_head;
-        new_head->prev = target_user->suggestedTail;
 
-        /* Update the tail of the target user*/
-        target_user->suggestedTail = new_tail;
+    for (i = 0; i < 6; ++i) {
+        if ((category_mask & (1U << i)) == 0) continue;
+        total += category_array[i].size;
+        max_runs += MaxCategoryRuns(&category_array[i]);
+    }
+
+    runs = (struct merge_run*) malloc((max_runs + 1) * sizeof(struct merge_run));
+    pos = (unsigned*) malloc((total + 1) * sizeof(unsigned));
+    sink.out = (struct movie_info*) malloc((total + 1) * sizeof(struct movie_info));
+    sink.n = 0;
+    if (runs == NULL || pos == NULL || sink.out == NULL) {
+        fprintf(stderr, "Malloc error\n");
+        free(runs);
+        free(pos);
+        free(sink.out);
+        return -1;
+    }
+
+    /* The year predicate is applied once, by the year index or the filter kernel */
+    total = 0;
+    for (i = 0; i < 6; ++i) {
+        if ((category_mask & (1U << i)) == 0) continue;
+
+        k += CategoryRuns(&category_array[i], year, runs + k, pos + total);
+        total += category_array[i].size;
     }
 
-    printf("F <%d> <%d> <%d> <%d>\n", uid, category1, category2, year);
-    printf("   User <%d> ", uid);
-    print_sug_list(target_user->suggestedHead);
-    printf("DONE\n");
+    code = MergeRuns(runs, k, ArraySink, &sink);
+
+    free(runs);
+    free(pos);
+
+    /* Append the merged movies to the suggested list of the user*/
+    if (code == 0 && dedupe_suggestions) code = SuggestedDedupe(target_user, sink.out, &sink.n);
+    if (code == 0) code = AppendSuggested(target_user, sink.out, sink.n, &added, &added_pos);
+    free(sink.out);
+    if (code == -1) return code;
+
+    OutputString("Q <");
+    OutputInt(uid);
+    OutputString("> <");
+    OutputUnsigned(category_mask);
+    OutputString("> <");
+    OutputInt(year);
+    OutputString(">\n");
+    print_search_result(uid, target_user, added, added_pos);
+    OutputString("DONE\n");
     return 0;
 }
 
@@ -1128,22 +2491,51 @@ int filtered_movie_search(int uid, movieCategory_t category1,
  * from the corresponding category list.
  */
 void take_off_movie(unsigned mid) {
-    struct user* user_tmp = user_list;
+    take_off_movies(&mid, 1);
+}
 
-    printf("T <%d>\n", mid);
-    
-    /* Remove from suggested lists*/
-    while (user_tmp != guard) {
-        if (RemoveFromSuggList(mid, &user_tmp->suggestedHead,\
-                                &user_tmp->suggestedTail) == 0) {
-            printf("   <%d> removed from <%d> suggested list.\n", mid, user_tmp->uid);
+/*
+ * Take off movies - n consecutive T events
+ *
+ * Every movie of mids is taken off as event T does, with
+ * the same output, but the category lists are compacted
+ * once for all of them at the end.
+ *
+ * Returns the number of movies found and taken off
+ */
+unsigned take_off_movies(const unsigned* mids, unsigned n) {
+    struct removal one;
+    struct removal* removals = &one;
+    unsigned count = 0;
+    unsigned found = 0;
+    unsigned i;
+
+    if (n > 1) {
+        removals = (struct removal*) malloc(n * sizeof(struct removal));
+
+        /* Without room for the batch the movies are taken off one by one */
+        if (removals == NULL) {
+            for (i = 0; i < n; ++i) found += take_off_movies(&mids[i], 1);
+            return found;
         }
-        user_tmp = user_tmp->next;
     }
 
-    /* Remove from category list*/
-    RemoveFromTable(mid);
-    printf("DONE\n");
+    for (i = 0; i < n; ++i) {
+        OutputString("T <");
+        OutputInt(mids[i]);
+        OutputString(">\n");
+
+        /* Remove from suggested lists*/
+        RemoveFromSuggLists(mids[i]);
+
+        /* Remove from category list, once the whole batch is marked */
+        count = MarkInTable(mids[i], removals, count);
+        OutputString("DONE\n");
+    }
+
+    RemoveFromTable(removals, count);
+    if (removals != &one) free(removals);
+    return count;
 }
 
 /*
@@ -1153,9 +2545,9 @@ void take_off_movie(unsigned mid) {
  * per-category lists
  */
 void print_movies(void) {
-    printf("M\nCategorized Movies:\n");
+    OutputString("M\nCategorized Movies:\n");
     print_table();
-    printf("DONE\n");
+    OutputString("DONE\n");
 }
 
 /*
@@ -1166,28 +2558,33 @@ void print_movies(void) {
  */
 void print_users(void) {
     struct user* tmp = user_list;
-    struct suggested_movie* sug_tmp;
 
-    printf("P\nUsers:\n");
+    OutputString("P\nUsers:\n");
 
     while (tmp != guard) {
         /* Print Suggested movies */
-        sug_tmp = tmp->suggestedHead;
-        printf("  <%d>:\n", tmp->uid);
-        printf("   Suggested: ");
-
-        while (sug_tmp != NULL) {
-            printf("<%d>", sug_tmp->info.mid);
-            sug_tmp = sug_tmp->next;
-            if (sug_tmp != NULL) printf(", ");
-        }
-        putchar('\n');
+        OutputString("  <");
+        OutputInt(tmp->uid);
+        OutputString(">:\n");
+        print_sug_from("   Suggested: ", tmp->suggestedHead, 0);
 
         /* Print Watch History*/
-        printf("   ");
+        OutputString("   ");
         print_watch_stack(tmp->watchHistory);
 
         tmp = tmp->next;
     }
-    printf("DONE\n");
-}
\ No newline at end of file
+    OutputString("DONE\n");
+}
+
+/*
+ * Print memory - Event I
+ *
+ * Prints the memory taken by every
+ * structure, see MemoryReport()
+ */
+void print_memory(void) {
+    OutputString("I\nMemory:\n");
+    MemoryReport(OutputString);
+    OutputString("DONE\n");
+}
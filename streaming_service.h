@@ -16,6 +16,10 @@
 
 #define __CS240_STREAMING_SERVICE_H__
 
+#include "hash_table.h"
+#include "mid_set.h"
+#include "pool.h"
+
 typedef enum {
 	HORROR,
 	SCIFI,
@@ -30,8 +34,17 @@ struct movie_info {
 	unsigned year;
 };
 
+/* Movies in one chunk of a watch stack, a chunk fills 128 bytes */
+#define WATCH_CHUNK 14
+
+/*
+ * Chunk of a watch stack. info[0..count-1] are its movies, the top one
+ * last. count is never 0, an emptied chunk is freed. next is the chunk
+ * below it.
+ */
 struct movie {
-	struct movie_info info;
+	struct movie_info info[WATCH_CHUNK];
+	unsigned count;
 	struct movie *next;
 };
 
@@ -41,17 +54,84 @@ struct new_movie {
 	struct new_movie *next;
 };
 
+/* Movies in one segment of a suggested list */
+#define SUGG_SEGMENT 16
+
+/* A segment left with at most this many movies by an erase merges into a neighbour */
+#define SUGG_MERGE (SUGG_SEGMENT / 4)
+
+/*
+ * A movie of a suggested list, kept in a slot of refs[] of its segment.
+ * It stays in that slot while the movies of the segment are shifted,
+ * and moves only to another segment.
+ */
 struct suggested_movie {
+	struct sugg_segment *segment;		/* Segment holding the movie */
+	struct suggested_movie *ref_prev;	/* Other movies with the same mid, */
+	struct suggested_movie *ref_next;	/* chained from suggestion_index */
+};
+
+/*
+ * Segment of a suggested list, a DLL of segments. info[0..count-1]
+ * are its movies in list order, count is never 0 (an emptied segment
+ * is freed) and refs[slot[i]] is the suggested_movie of info[i].
+ * slot[] is a permutation of the slots, the free ones after count.
+ */
+struct sugg_segment {
+	struct sugg_segment *prev;
+	struct sugg_segment *next;
+	struct user *owner;			/* User whose suggested list holds the segment */
+	unsigned long seq;			/* Increases along the list, see SuggSegmentLabel() */
+	unsigned count;
+	unsigned char slot[SUGG_SEGMENT];	/* On the cache line of count, both change on every erase */
+	struct movie_info info[SUGG_SEGMENT];
+	struct suggested_movie refs[SUGG_SEGMENT];
+};
+
+/* Year index bucket: the mids of the movies of a category released in year, sorted */
+struct year_bucket {
+	unsigned year;
+	unsigned *mids;
+	unsigned size;
+	unsigned sorted;	/* mids[0..sorted) is sorted, the rest was just appended */
+	unsigned capacity;
+};
+
+/*
+ * Category list: the movies of a category sorted by mid,
+ * kept as two parallel arrays (mids[i] has release year years[i]).
+ * buckets is the year index of the list, sorted by year.
+*/
+struct category_list {
+	unsigned *mids;
+	unsigned *years;
+	unsigned size;
+	unsigned capacity;
+	struct year_bucket *buckets;
+	unsigned nbuckets;
+	unsigned bucket_capacity;
+};
+
+/*
+ * Value of movie_index: a distributed movie and the list holding it.
+ * A mid added again after it was distributed is held once more, so the
+ * entries of a mid are chained in the order the category table is
+ * searched: by category, then oldest first.
+*/
+struct catalog_entry {
 	struct movie_info info;
-	struct suggested_movie *prev;
-	struct suggested_movie *next;
+	movieCategory_t category;
+	struct catalog_entry *next;
 };
 
 struct user {
 	int uid;
-	struct suggested_movie *suggestedHead;
-	struct suggested_movie *suggestedTail;
+	unsigned long order;	/* Registration number, decreasing along user_list */
+	struct sugg_segment *suggestedHead;
+	struct sugg_segment *suggestedTail;
+	struct mid_set suggestedSet;	/* Mids of the suggested list and their counts, with --dedupe only */
 	struct movie *watchHistory;
+	struct user *prev;
 	struct user *next;
 };
 
@@ -63,8 +143,28 @@ struct user {
 
 extern struct user* user_list;
 extern struct user* guard;
-extern struct movie* category_array[6]; 	/* Each element is the head of an SLL */
+extern struct hash_table user_index;	/* uid -> node of user_list */
+extern struct category_list category_array[6]; 	/* Sorted movies of each category */
 extern struct new_movie* new_movies_list;	/* Head of new movies, SLL */
+extern struct new_movie* staged_movies;	/* New movies not yet merged into new_movies_list, unsorted SLL */
+extern struct hash_table movie_index;	/* mid -> struct catalog_entry */
+extern struct hash_table new_movie_index;	/* mid -> struct new_movie, staged or not */
+extern struct hash_table suggestion_index;	/* mid -> chain of struct suggested_movie */
+
+/* Node allocators, one for each node type (segments for suggested lists) */
+extern struct pool movie_pool;
+extern struct pool suggested_pool;
+extern struct pool new_movie_pool;
+extern struct pool user_pool;
+
+/*
+ * When not 0, events S, F and Q do not add to a suggested list the
+ * movies it already holds, nor a movie twice. 0 (the default) keeps
+ * every copy, as the events always did. The suggested sets of the users
+ * are kept only when it is set, so it is set before the first event.
+ * Defined in streaming_service.c.
+ */
+extern int dedupe_suggestions;
 
 /*
  * Register User - Event R
@@ -88,8 +188,11 @@ int register_user(int uid);
  * user exists, after clearing the
  * user's suggested movie list and
  * watch history stack
+ *
+ * Returns 0 on success, -1 on failure
+ * (user not found)
  */
-void unregister_user(int uid);
+int unregister_user(int uid);
 
 /*
  * Add new movie - Event A
@@ -167,6 +270,22 @@ int suggest_movies(int uid);
 int filtered_movie_search(int uid, movieCategory_t category1,
 		movieCategory_t category2, unsigned year);
 
+/*
+ * Multi-category filtered search - Event Q
+ *
+ * User uid asks to be suggested movies belonging
+ * to any category c with bit (1 << c) set in
+ * category_mask and with release year >= year.
+ * The movies are appended to the suggested list
+ * in increasing order based on movie ID. This
+ * event is implemented with time complexity
+ * O(n * log k), where n is the total size of the
+ * k selected category lists
+ *
+ * Returns 0 on success, -1 on failure
+ */
+int filtered_multi_search(int uid, unsigned category_mask, unsigned year);
+
 /*
  * Take off movie - Event T
  *
@@ -176,6 +295,17 @@ int filtered_movie_search(int uid, movieCategory_t category1,
  */
 void take_off_movie(unsigned mid);
 
+/*
+ * Take off movies - n consecutive T events
+ *
+ * Every movie of mids is taken off as event T does, with
+ * the same output, but the category lists are compacted
+ * once for all of them at the end.
+ *
+ * Returns the number of movies found and taken off
+ */
+unsigned take_off_movies(const unsigned *mids, unsigned n);
+
 /*
  * Print movies - Event M
  *
@@ -191,4 +321,18 @@ void print_movies(void);
  * users list
  */
 void print_users(void);
+
+/*
+ * Print memory - Event I
+ *
+ * Prints the nodes and bytes taken by
+ * every structure, now and at their peak
+ */
+void print_memory(void);
+
+/*
+ * Pass the lines of the memory report
+ * printed by event I to put, one at a time
+ */
+void MemoryReport(void (*put)(const char *));
 #endif
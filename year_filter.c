@@ -0,0 +1,179 @@
+/*
+ * Function definitions for the year filter kernels declared in year_filter.h.
+ *
+ * The vector kernels compare a block of years at once, turn the result
+ * into a bit mask and use it to pick, from a precomputed table, the lane
+ * numbers of the movies that pass. Those are stored with one unaligned
+ * store and the output position advances by the number of set bits.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "year_filter.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define YEAR_FILTER_X86
+#include <immintrin.h>
+#endif
+
+typedef unsigned (*filter_kernel)(const unsigned* years, unsigned n,
+                                  unsigned year, unsigned* out);
+
+static filter_kernel kernel = NULL;     /* Selected kernel */
+static const char* kernel_name = NULL;
+
+/* Portable kernel, without branches on the year comparison */
+static unsigned FilterScalar(const unsigned* years, unsigned n,
+                             unsigned year, unsigned* out) {
+    unsigned i = 0;
+    unsigned k = 0;
+
+    for (i = 0; i < n; ++i) {
+        out[k] = i;
+        k += (years[i] >= year);
+    }
+
+    return k;
+}
+
+#ifdef YEAR_FILTER_X86
+
+/* lane_offsets[m] lists the set bits of mask m, padded with zeros */
+static unsigned lane_offsets4[16][4];
+static unsigned lane_offsets8[256][8];
+static unsigned char bit_count[256];
+
+static void InitTables(void) {
+    static int done = 0;
+    unsigned m, b, k;
+
+    if (done) return;
+
+    for (m = 0; m < 256; ++m) {
+        k = 0;
+        for (b = 0; b < 8; ++b) {
+            if (m & (1U << b)) {
+                lane_offsets8[m][k] = b;
+                if (m < 16) lane_offsets4[m][k] = b;
+                k++;
+            }
+        }
+        bit_count[m] = (unsigned char)k;
+    }
+
+    done = 1;
+}
+
+/*
+ * SSE2 has only signed comparisons, so both sides are biased by 2^31.
+ * years[i] >= year is tested as years[i] > year - 1 (year > 0).
+*/
+__attribute__((target("sse2")))
+static unsigned FilterSSE2(const unsigned* years, unsigned n,
+                           unsigned year, unsigned* out) {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000U);
+    __m128i limit, v, pos;
+    unsigned i = 0;
+    unsigned k = 0;
+    unsigned mask;
+
+    if (year == 0) return FilterScalar(years, n, year, out);
+
+    limit = _mm_set1_epi32((int)((year - 1) ^ 0x80000000U));
+
+    for (i = 0; i + 4 <= n; i += 4) {
+        v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(years + i)), bias);
+        mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, limit)));
+
+        pos = _mm_add_epi32(_mm_set1_epi32((int)i),
+                            _mm_loadu_si128((const __m128i*)lane_offsets4[mask]));
+        _mm_storeu_si128((__m128i*)(out + k), pos);
+        k += bit_count[mask];
+    }
+
+    for (; i < n; ++i) {
+        out[k] = i;
+        k += (years[i] >= year);
+    }
+
+    return k;
+}
+
+/* Same as FilterSSE2, eight years at a time */
+__attribute__((target("avx2")))
+static unsigned FilterAVX2(const unsigned* years, unsigned n,
+                           unsigned year, unsigned* out) {
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000U);
+    __m256i limit, v, pos;
+    unsigned i = 0;
+    unsigned k = 0;
+    unsigned mask;
+
+    if (year == 0) return FilterScalar(years, n, year, out);
+
+    limit = _mm256_set1_epi32((int)((year - 1) ^ 0x80000000U));
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(years + i)), bias);
+        mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, limit)));
+
+        pos = _mm256_add_epi32(_mm256_set1_epi32((int)i),
+                               _mm256_loadu_si256((const __m256i*)lane_offsets8[mask]));
+        _mm256_storeu_si256((__m256i*)(out + k), pos);
+        k += bit_count[mask];
+    }
+
+    for (; i < n; ++i) {
+        out[k] = i;
+        k += (years[i] >= year);
+    }
+
+    return k;
+}
+
+#endif /* YEAR_FILTER_X86 */
+
+int YearFilterSelect(const char* name) {
+#ifdef YEAR_FILTER_X86
+    int has_sse2, has_avx2;
+
+    InitTables();
+    __builtin_cpu_init();
+    has_sse2 = __builtin_cpu_supports("sse2");
+    has_avx2 = __builtin_cpu_supports("avx2");
+
+    if (strcmp(name, "auto") == 0) name = has_avx2 ? "avx2" : (has_sse2 ? "sse2" : "scalar");
+
+    if (strcmp(name, "avx2") == 0) {
+        if (!has_avx2) return -1;
+        kernel = FilterAVX2;
+        kernel_name = "avx2";
+        return 0;
+    }
+    if (strcmp(name, "sse2") == 0) {
+        if (!has_sse2) return -1;
+        kernel = FilterSSE2;
+        kernel_name = "sse2";
+        return 0;
+    }
+#else
+    if (strcmp(name, "auto") == 0) name = "scalar";
+#endif /* YEAR_FILTER_X86 */
+
+    if (strcmp(name, "scalar") == 0) {
+        kernel = FilterScalar;
+        kernel_name = "scalar";
+        return 0;
+    }
+
+    return -1;
+}
+
+const char* YearFilterName(void) {
+    if (kernel == NULL) YearFilterSelect("auto");
+    return kernel_name;
+}
+
+unsigned YearFilter(const unsigned* years, unsigned n, unsigned year, unsigned* out) {
+    if (kernel == NULL) YearFilterSelect("auto");
+    return kernel(years, n, year, out);
+}
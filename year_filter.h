@@ -0,0 +1,29 @@
+/*
+ * Year filter kernels used by filtered_movie_search (event F).
+ *
+ * A kernel scans a years column of a category list in blocks and
+ * writes out the positions of the movies released in or after a given
+ * year, in increasing order. There is a portable scalar kernel and,
+ * on x86, SSE2 and AVX2 kernels. The kernel is chosen at runtime.
+*/
+#ifndef YEAR_FILTER_H
+#define YEAR_FILTER_H
+
+/*
+ * Select the kernel by name: "scalar", "sse2", "avx2" or "auto"
+ * (the fastest one the CPU supports, also used if none is selected).
+ * Returns 0 on success, -1 if the name is unknown or the CPU lacks support.
+*/
+int YearFilterSelect(const char* name);
+
+/* Name of the selected kernel */
+const char* YearFilterName(void);
+
+/*
+ * Write to out the positions i of years[0..n) with years[i] >= year,
+ * in increasing order. out must have room for n positions.
+ * Returns the number of positions written.
+*/
+unsigned YearFilter(const unsigned* years, unsigned n, unsigned year, unsigned* out);
+
+#endif /* YEAR_FILTER_H */